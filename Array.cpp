@@ -1,5 +1,5 @@
 #include "Array.h"
-#include <sstream>
+#include "BinaryFormat.h"
 
 using namespace std;
 
@@ -70,28 +70,45 @@ size_t getArrayLength(const Array* mArray) {
     return mArray->len;
 }
 
-std::string Array::serialize() const {
-    std::ostringstream oss;
-    oss << "M " << name << " " << len;
+void Array::serializeTo(Writer& out) const {
+    out.write("M ");
+    out.write(name);
+    out.put(' ');
+    out.writeNumber(len);
     for (int i = 0; i < len; ++i) {
-        oss << " " << (head + i)->data;
+        out.put(' ');
+        out.write(head[i].data);
     }
-    return oss.str();
 }
 
-void Array::deserialize(const std::string& data) {
-    std::istringstream iss(data);
-    std::string type;
-    iss >> type; // Тип M
-    iss >> name;
-    int count = 0;
-    iss >> count;
+void Array::deserializeFrom(std::string_view data) {
+    TextReader in(data);
+    in.next(); // Тип M
+    name = std::string(in.next());
+    int count = static_cast<int>(in.nextNumber<std::uint32_t>());
     // очистка существующих данных
     if (head) { delete[] head; head = nullptr; }
-    createArray(const_cast<Array*>(this), std::max(10, count));
+    createArray(this, std::max(10, count));
     for (int i = 0; i < count; ++i) {
-        std::string v; iss >> v;
-        setKeyArray(const_cast<Array*>(this), v, i);
+        head[i].data = std::string(in.next());
+    }
+    len = count;
+}
+
+void Array::serializeBinary(std::string& out) const {
+    appendU64(out, static_cast<std::uint64_t>(len));
+    for (int i = 0; i < len; ++i) {
+        appendString(out, head[i].data);
+    }
+}
+
+void Array::deserializeBinary(const char* data, std::size_t size) {
+    BinaryReader in(data, size);
+    int count = static_cast<int>(in.readU64());
+    if (head) { delete[] head; head = nullptr; }
+    createArray(this, std::max(10, count));
+    for (int i = 0; i < count; ++i) {
+        head[i].data = in.readString();
     }
     len = count;
 }
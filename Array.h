@@ -43,15 +43,28 @@ struct Array : public Structure {
     
     /**
      * @brief Сериализует массив в формат: "M name count elem1 elem2 ..."
-     * @return Строка с сохраненным состоянием массива
+     * @param out Буфер записи, в который дописывается строка
      */
-    std::string serialize() const override;
+    void serializeTo(Writer& out) const override;
     
     /**
      * @brief Десериализует массив из строки формата "M name count elem1 elem2 ..."
      * @param data Строка с сохраненными данными массива
      */
-    void deserialize(const std::string& data) override;
+    void deserializeFrom(std::string_view data) override;
+
+    /**
+     * @brief Записывает массив в бинарной форме: uint64 count, затем элементы с префиксом длины
+     * @param out Буфер для дописывания данных
+     */
+    void serializeBinary(std::string& out) const override;
+
+    /**
+     * @brief Восстанавливает массив из бинарной формы
+     * @param data Начало полезной нагрузки
+     * @param size Длина полезной нагрузки в байтах
+     */
+    void deserializeBinary(const char* data, std::size_t size) override;
 };
 
 /**
@@ -0,0 +1,554 @@
+#include "BPlusTree.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "BinaryFormat.h"
+
+// Глубина дерева: при заполнении узлов не меньше чем наполовину ее хватает с запасом
+static const int BPLUS_MAX_DEPTH = 32;
+
+/*
+ * Бинарный поиск внутри узла без ветвлений: на каждом шаге база сдвигается
+ * условным присваиванием (cmov), число шагов зависит только от count,
+ * поэтому предсказатель переходов не ошибается на случайных ключах.
+ */
+
+// Количество ключей, меньших key
+static inline int lowerBoundKeys(const int* keys, int count, int key) {
+    if (count == 0) return 0;
+    const int* base = keys;
+    int n = count;
+    while (n > 1) {
+        int half = n / 2;
+        base = base[half] < key ? base + half : base;
+        n -= half;
+    }
+    return static_cast<int>(base - keys) + (*base < key);
+}
+
+// Количество ключей, не больших key (номер потомка внутреннего узла)
+static inline int upperBoundKeys(const int* keys, int count, int key) {
+    if (count == 0) return 0;
+    const int* base = keys;
+    int n = count;
+    while (n > 1) {
+        int half = n / 2;
+        base = base[half] <= key ? base + half : base;
+        n -= half;
+    }
+    return static_cast<int>(base - keys) + (*base <= key);
+}
+
+static BPlusLeaf* findLeaf(BPlusNode* node, int key) {
+    if (!node) return nullptr;
+    while (!node->leaf) {
+        BPlusInner* inner = static_cast<BPlusInner*>(node);
+        node = inner->children[upperBoundKeys(inner->keys, inner->count, key)];
+    }
+    return static_cast<BPlusLeaf*>(node);
+}
+
+// Количество ключей в поддереве узла
+static std::size_t subtreeKeys(const BPlusNode* node) {
+    if (node->leaf) return static_cast<std::size_t>(node->count);
+    const BPlusInner* inner = static_cast<const BPlusInner*>(node);
+    return std::accumulate(inner->sizes, inner->sizes + inner->count + 1, std::size_t{0});
+}
+
+static void deleteBPlusNode(BPlusNode* node) {
+    if (node->leaf) delete static_cast<BPlusLeaf*>(node);
+    else delete static_cast<BPlusInner*>(node);
+}
+
+void clearBPlusTree(BPlusTree* tree) {
+    std::vector<BPlusNode*> stack;
+    if (tree->root) stack.push_back(tree->root);
+    while (!stack.empty()) {
+        BPlusNode* node = stack.back();
+        stack.pop_back();
+        if (!node->leaf) {
+            BPlusInner* inner = static_cast<BPlusInner*>(node);
+            stack.insert(stack.end(), inner->children, inner->children + inner->count + 1);
+        }
+        deleteBPlusNode(node);
+    }
+    tree->root = nullptr;
+    tree->first = nullptr;
+    tree->size = 0;
+}
+
+bool containsKeyBPlus(const BPlusTree& tree, int key) {
+    const BPlusLeaf* leaf = findLeaf(tree.root, key);
+    if (!leaf) return false;
+    int pos = lowerBoundKeys(leaf->keys, leaf->count, key);
+    return pos < leaf->count && leaf->keys[pos] == key;
+}
+
+void containsKeysBPlus(const BPlusTree& tree, const std::vector<int>& keys, std::vector<char>& found) {
+    found.assign(keys.size(), 0);
+    if (!tree.root || keys.empty()) return;
+
+    std::vector<std::size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::sort(order.begin(), order.end(),
+              [&keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+
+    // Ключи идут по возрастанию: пока ключ не вышел за последний ключ листа,
+    // он ищется в том же листе; соседний лист берется по ссылке next, а спуск
+    // от корня нужен только при скачке через несколько листьев
+    const BPlusLeaf* leaf = nullptr;
+    for (std::size_t i : order) {
+        int key = keys[i];
+        if (!leaf || key > leaf->keys[leaf->count - 1]) {
+            const BPlusLeaf* next = leaf ? leaf->next : nullptr;
+            if (next && key <= next->keys[next->count - 1]) {
+                leaf = next;
+            } else {
+                leaf = findLeaf(tree.root, key);
+            }
+        }
+        int pos = lowerBoundKeys(leaf->keys, leaf->count, key);
+        found[i] = pos < leaf->count && leaf->keys[pos] == key;
+    }
+}
+
+// Количество ключей, меньших key (inclusive: не больших key)
+static std::size_t countBelow(const BPlusTree& tree, int key, bool inclusive) {
+    const BPlusNode* node = tree.root;
+    if (!node) return 0;
+    std::size_t below = 0;
+    while (!node->leaf) {
+        const BPlusInner* inner = static_cast<const BPlusInner*>(node);
+        int slot = upperBoundKeys(inner->keys, inner->count, key);
+        below = std::accumulate(inner->sizes, inner->sizes + slot, below);
+        node = inner->children[slot];
+    }
+    const BPlusLeaf* leaf = static_cast<const BPlusLeaf*>(node);
+    return below + static_cast<std::size_t>(inclusive ? upperBoundKeys(leaf->keys, leaf->count, key)
+                                                      : lowerBoundKeys(leaf->keys, leaf->count, key));
+}
+
+std::size_t rankKeyBPlus(const BPlusTree& tree, int key) {
+    return countBelow(tree, key, false);
+}
+
+std::size_t countRangeBPlus(const BPlusTree& tree, int lo, int hi) {
+    if (hi < lo) return 0;
+    return countBelow(tree, hi, true) - countBelow(tree, lo, false);
+}
+
+int selectKeyBPlus(const BPlusTree& tree, std::size_t k) {
+    if (k >= tree.size) throw std::runtime_error("Индекс вне диапазона");
+    const BPlusNode* node = tree.root;
+    while (!node->leaf) {
+        const BPlusInner* inner = static_cast<const BPlusInner*>(node);
+        int slot = 0;
+        while (k >= inner->sizes[slot]) k -= inner->sizes[slot++];
+        node = inner->children[slot];
+    }
+    return static_cast<const BPlusLeaf*>(node)->keys[k];
+}
+
+std::size_t leafCountBPlus(const BPlusTree& tree) {
+    std::size_t count = 0;
+    for (const BPlusLeaf* leaf = tree.first; leaf; leaf = leaf->next) ++count;
+    return count;
+}
+
+BPlusCursor lowerBoundBPlus(const BPlusTree& tree, int key) {
+    BPlusCursor cursor;
+    cursor.leaf = findLeaf(tree.root, key);
+    if (!cursor.leaf) return cursor;
+    cursor.pos = lowerBoundKeys(cursor.leaf->keys, cursor.leaf->count, key);
+    if (cursor.pos == cursor.leaf->count) {
+        cursor.leaf = cursor.leaf->next;
+        cursor.pos = 0;
+    }
+    return cursor;
+}
+
+void insertKeyBPlus(BPlusTree* tree, int key) {
+    if (tree->root == nullptr) {
+        BPlusLeaf* leaf = new BPlusLeaf;
+        leaf->keys[0] = key;
+        leaf->count = 1;
+        tree->root = tree->first = leaf;
+        tree->size = 1;
+        return;
+    }
+
+    // Путь от корня: узел и номер потомка, в который спустились
+    BPlusInner* path[BPLUS_MAX_DEPTH];
+    int slots[BPLUS_MAX_DEPTH];
+    int depth = 0;
+    BPlusNode* node = tree->root;
+    while (!node->leaf) {
+        BPlusInner* inner = static_cast<BPlusInner*>(node);
+        int slot = upperBoundKeys(inner->keys, inner->count, key);
+        path[depth] = inner;
+        slots[depth] = slot;
+        ++depth;
+        node = inner->children[slot];
+    }
+
+    BPlusLeaf* leaf = static_cast<BPlusLeaf*>(node);
+    int pos = lowerBoundKeys(leaf->keys, leaf->count, key);
+    if (pos < leaf->count && leaf->keys[pos] == key) {
+        throw std::runtime_error("Ключ уже существует в дереве");
+    }
+    ++tree->size;
+    for (int level = 0; level < depth; ++level) ++path[level]->sizes[slots[level]];
+    if (leaf->count < BPLUS_ORDER) {
+        std::copy_backward(leaf->keys + pos, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        leaf->keys[pos] = key;
+        ++leaf->count;
+        return;
+    }
+
+    // Лист полон: BPLUS_ORDER + 1 ключей делятся между ним и новым правым соседом
+    int merged[BPLUS_ORDER + 1];
+    std::copy(leaf->keys, leaf->keys + pos, merged);
+    merged[pos] = key;
+    std::copy(leaf->keys + pos, leaf->keys + BPLUS_ORDER, merged + pos + 1);
+    bool append = pos == BPLUS_ORDER && leaf->next == nullptr;
+    int leftCount = append ? BPLUS_ORDER : (BPLUS_ORDER + 1) / 2;
+
+    BPlusLeaf* right = new BPlusLeaf;
+    std::copy(merged, merged + leftCount, leaf->keys);
+    leaf->count = leftCount;
+    std::copy(merged + leftCount, merged + BPLUS_ORDER + 1, right->keys);
+    right->count = BPLUS_ORDER + 1 - leftCount;
+    right->next = leaf->next;
+    right->prev = leaf;
+    if (leaf->next) leaf->next->prev = right;
+    leaf->next = right;
+
+    int separator = right->keys[0];
+    BPlusNode* newChild = right;
+    while (depth > 0) {
+        --depth;
+        BPlusInner* parent = path[depth];
+        int slot = slots[depth];
+        // Счетчик sizes[slot] уже включает ключи, ушедшие в newChild
+        std::size_t moved = subtreeKeys(newChild);
+        if (parent->count < BPLUS_ORDER) {
+            std::copy_backward(parent->keys + slot, parent->keys + parent->count, parent->keys + parent->count + 1);
+            std::copy_backward(parent->children + slot + 1, parent->children + parent->count + 1,
+                               parent->children + parent->count + 2);
+            std::copy_backward(parent->sizes + slot + 1, parent->sizes + parent->count + 1,
+                               parent->sizes + parent->count + 2);
+            parent->keys[slot] = separator;
+            parent->children[slot + 1] = newChild;
+            parent->sizes[slot] -= moved;
+            parent->sizes[slot + 1] = moved;
+            ++parent->count;
+            return;
+        }
+
+        // Внутренний узел полон: средний разделитель поднимается выше
+        int keys[BPLUS_ORDER + 1];
+        BPlusNode* children[BPLUS_ORDER + 2];
+        std::size_t sizes[BPLUS_ORDER + 2];
+        std::copy(parent->keys, parent->keys + slot, keys);
+        keys[slot] = separator;
+        std::copy(parent->keys + slot, parent->keys + BPLUS_ORDER, keys + slot + 1);
+        std::copy(parent->children, parent->children + slot + 1, children);
+        children[slot + 1] = newChild;
+        std::copy(parent->children + slot + 1, parent->children + BPLUS_ORDER + 1, children + slot + 2);
+        std::copy(parent->sizes, parent->sizes + slot + 1, sizes);
+        sizes[slot] -= moved;
+        sizes[slot + 1] = moved;
+        std::copy(parent->sizes + slot + 1, parent->sizes + BPLUS_ORDER + 1, sizes + slot + 2);
+        int mid = slot == BPLUS_ORDER ? BPLUS_ORDER - 1 : BPLUS_ORDER / 2;
+
+        BPlusInner* sibling = new BPlusInner;
+        std::copy(keys, keys + mid, parent->keys);
+        std::copy(children, children + mid + 1, parent->children);
+        std::copy(sizes, sizes + mid + 1, parent->sizes);
+        parent->count = mid;
+        std::copy(keys + mid + 1, keys + BPLUS_ORDER + 1, sibling->keys);
+        std::copy(children + mid + 1, children + BPLUS_ORDER + 2, sibling->children);
+        std::copy(sizes + mid + 1, sizes + BPLUS_ORDER + 2, sibling->sizes);
+        sibling->count = BPLUS_ORDER - mid;
+        separator = keys[mid];
+        newChild = sibling;
+    }
+
+    BPlusInner* root = new BPlusInner;
+    root->count = 1;
+    root->keys[0] = separator;
+    root->children[0] = tree->root;
+    root->children[1] = newChild;
+    root->sizes[1] = subtreeKeys(newChild);
+    root->sizes[0] = tree->size - root->sizes[1];
+    tree->root = root;
+}
+
+// Удаляет из внутреннего узла разделитель keys[i] и потомка children[i + 1];
+// ключи потомка к этому моменту уже учтены в sizes[i]
+static void removeFromInner(BPlusInner* inner, int i) {
+    std::copy(inner->keys + i + 1, inner->keys + inner->count, inner->keys + i);
+    std::copy(inner->children + i + 2, inner->children + inner->count + 1, inner->children + i + 1);
+    std::copy(inner->sizes + i + 2, inner->sizes + inner->count + 1, inner->sizes + i + 1);
+    --inner->count;
+}
+
+// Восстанавливает заполнение листа parent->children[slot]
+static void fixLeafUnderflow(BPlusInner* parent, int slot) {
+    BPlusLeaf* leaf = static_cast<BPlusLeaf*>(parent->children[slot]);
+    BPlusLeaf* left = slot > 0 ? static_cast<BPlusLeaf*>(parent->children[slot - 1]) : nullptr;
+    BPlusLeaf* right = slot < parent->count ? static_cast<BPlusLeaf*>(parent->children[slot + 1]) : nullptr;
+
+    if (left && left->count > BPLUS_MIN_KEYS) {
+        std::copy_backward(leaf->keys, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+        leaf->keys[0] = left->keys[--left->count];
+        ++leaf->count;
+        parent->keys[slot - 1] = leaf->keys[0];
+        --parent->sizes[slot - 1];
+        ++parent->sizes[slot];
+        return;
+    }
+    if (right && right->count > BPLUS_MIN_KEYS) {
+        leaf->keys[leaf->count++] = right->keys[0];
+        std::copy(right->keys + 1, right->keys + right->count, right->keys);
+        --right->count;
+        parent->keys[slot] = right->keys[0];
+        --parent->sizes[slot + 1];
+        ++parent->sizes[slot];
+        return;
+    }
+
+    // Занять не у кого: лист сливается с соседом, правый из двух удаляется
+    if (!left) {
+        left = leaf;
+        leaf = right;
+        ++slot;
+    }
+    std::copy(leaf->keys, leaf->keys + leaf->count, left->keys + left->count);
+    left->count += leaf->count;
+    left->next = leaf->next;
+    if (leaf->next) leaf->next->prev = left;
+    parent->sizes[slot - 1] += parent->sizes[slot];
+    removeFromInner(parent, slot - 1);
+    delete leaf;
+}
+
+// Восстанавливает заполнение внутреннего узла parent->children[slot]
+static void fixInnerUnderflow(BPlusInner* parent, int slot) {
+    BPlusInner* node = static_cast<BPlusInner*>(parent->children[slot]);
+    BPlusInner* left = slot > 0 ? static_cast<BPlusInner*>(parent->children[slot - 1]) : nullptr;
+    BPlusInner* right = slot < parent->count ? static_cast<BPlusInner*>(parent->children[slot + 1]) : nullptr;
+
+    if (left && left->count > BPLUS_MIN_KEYS) {
+        // Разделитель родителя опускается в узел, последний ключ левого соседа поднимается
+        std::copy_backward(node->keys, node->keys + node->count, node->keys + node->count + 1);
+        std::copy_backward(node->children, node->children + node->count + 1, node->children + node->count + 2);
+        std::copy_backward(node->sizes, node->sizes + node->count + 1, node->sizes + node->count + 2);
+        std::size_t moved = left->sizes[left->count];
+        node->keys[0] = parent->keys[slot - 1];
+        node->children[0] = left->children[left->count];
+        node->sizes[0] = moved;
+        ++node->count;
+        parent->keys[slot - 1] = left->keys[--left->count];
+        parent->sizes[slot - 1] -= moved;
+        parent->sizes[slot] += moved;
+        return;
+    }
+    if (right && right->count > BPLUS_MIN_KEYS) {
+        std::size_t moved = right->sizes[0];
+        node->keys[node->count] = parent->keys[slot];
+        node->children[node->count + 1] = right->children[0];
+        node->sizes[node->count + 1] = moved;
+        ++node->count;
+        parent->keys[slot] = right->keys[0];
+        std::copy(right->keys + 1, right->keys + right->count, right->keys);
+        std::copy(right->children + 1, right->children + right->count + 1, right->children);
+        std::copy(right->sizes + 1, right->sizes + right->count + 1, right->sizes);
+        --right->count;
+        parent->sizes[slot + 1] -= moved;
+        parent->sizes[slot] += moved;
+        return;
+    }
+
+    if (!left) {
+        left = node;
+        node = right;
+        ++slot;
+    }
+    left->keys[left->count] = parent->keys[slot - 1];
+    std::copy(node->keys, node->keys + node->count, left->keys + left->count + 1);
+    std::copy(node->children, node->children + node->count + 1, left->children + left->count + 1);
+    std::copy(node->sizes, node->sizes + node->count + 1, left->sizes + left->count + 1);
+    left->count += node->count + 1;
+    parent->sizes[slot - 1] += parent->sizes[slot];
+    removeFromInner(parent, slot - 1);
+    delete node;
+}
+
+void deleteKeyBPlus(BPlusTree* tree, int key) {
+    if (tree->root == nullptr) {
+        throw std::runtime_error("Дерево пустое");
+    }
+
+    BPlusInner* path[BPLUS_MAX_DEPTH];
+    int slots[BPLUS_MAX_DEPTH];
+    int depth = 0;
+    BPlusNode* node = tree->root;
+    while (!node->leaf) {
+        BPlusInner* inner = static_cast<BPlusInner*>(node);
+        int slot = upperBoundKeys(inner->keys, inner->count, key);
+        path[depth] = inner;
+        slots[depth] = slot;
+        ++depth;
+        node = inner->children[slot];
+    }
+
+    BPlusLeaf* leaf = static_cast<BPlusLeaf*>(node);
+    int pos = lowerBoundKeys(leaf->keys, leaf->count, key);
+    if (pos == leaf->count || leaf->keys[pos] != key) {
+        throw std::runtime_error("Ключ не найден");
+    }
+    std::copy(leaf->keys + pos + 1, leaf->keys + leaf->count, leaf->keys + pos);
+    --leaf->count;
+    --tree->size;
+    for (int level = 0; level < depth; ++level) --path[level]->sizes[slots[level]];
+
+    // Разделители выше не трогаются: удаленный ключ остается корректной границей
+    if (depth == 0) {
+        if (leaf->count == 0) {
+            delete leaf;
+            tree->root = nullptr;
+            tree->first = nullptr;
+        }
+        return;
+    }
+    if (leaf->count >= BPLUS_MIN_KEYS) return;
+
+    fixLeafUnderflow(path[depth - 1], slots[depth - 1]);
+    for (int level = depth - 1; level > 0; --level) {
+        if (path[level]->count >= BPLUS_MIN_KEYS) break;
+        fixInnerUnderflow(path[level - 1], slots[level - 1]);
+    }
+
+    // Корень без разделителей заменяется единственным потомком
+    if (!tree->root->leaf && static_cast<BPlusInner*>(tree->root)->count == 0) {
+        BPlusInner* oldRoot = static_cast<BPlusInner*>(tree->root);
+        tree->root = oldRoot->children[0];
+        delete oldRoot;
+    }
+}
+
+void buildBPlusFromSorted(BPlusTree* tree, const int* keys, std::size_t count) {
+    clearBPlusTree(tree);
+    if (count == 0) return;
+    for (std::size_t i = 1; i < count; ++i) {
+        if (keys[i - 1] >= keys[i]) {
+            for (std::size_t j = 0; j < count; ++j) insertKeyBPlus(tree, keys[j]);
+            return;
+        }
+    }
+
+    // Листья: ключи делятся поровну, каждый лист заполнен не меньше чем наполовину
+    std::size_t leafCount = (count + BPLUS_ORDER - 1) / BPLUS_ORDER;
+    std::vector<BPlusNode*> level;
+    std::vector<int> mins;
+    std::vector<std::size_t> sizes;
+    level.reserve(leafCount);
+    mins.reserve(leafCount);
+    sizes.reserve(leafCount);
+    BPlusLeaf* prev = nullptr;
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < leafCount; ++i) {
+        std::size_t take = count / leafCount + (i < count % leafCount ? 1 : 0);
+        BPlusLeaf* leaf = new BPlusLeaf;
+        std::copy(keys + pos, keys + pos + take, leaf->keys);
+        leaf->count = static_cast<int>(take);
+        leaf->prev = prev;
+        if (prev) prev->next = leaf;
+        else tree->first = leaf;
+        prev = leaf;
+        level.push_back(leaf);
+        mins.push_back(keys[pos]);
+        sizes.push_back(take);
+        pos += take;
+    }
+
+    // Внутренние уровни: разделитель перед потомком - минимальный ключ его поддерева
+    while (level.size() > 1) {
+        std::size_t n = level.size();
+        std::size_t groups = (n + BPLUS_ORDER) / (BPLUS_ORDER + 1);
+        std::vector<BPlusNode*> upper;
+        std::vector<int> upperMins;
+        std::vector<std::size_t> upperSizes;
+        upper.reserve(groups);
+        upperMins.reserve(groups);
+        upperSizes.reserve(groups);
+        std::size_t idx = 0;
+        for (std::size_t g = 0; g < groups; ++g) {
+            std::size_t take = n / groups + (g < n % groups ? 1 : 0);
+            BPlusInner* inner = new BPlusInner;
+            std::size_t total = 0;
+            for (std::size_t k = 0; k < take; ++k) {
+                inner->children[k] = level[idx + k];
+                inner->sizes[k] = sizes[idx + k];
+                total += sizes[idx + k];
+                if (k > 0) inner->keys[k - 1] = mins[idx + k];
+            }
+            inner->count = static_cast<int>(take - 1);
+            upper.push_back(inner);
+            upperMins.push_back(mins[idx]);
+            upperSizes.push_back(total);
+            idx += take;
+        }
+        level.swap(upper);
+        mins.swap(upperMins);
+        sizes.swap(upperSizes);
+    }
+    tree->root = level[0];
+    tree->size = count;
+}
+
+void BPlusTree::serializeTo(Writer& out) const {
+    out.write("B ");
+    out.write(name);
+    out.put(' ');
+    out.writeNumber(static_cast<std::uint64_t>(size));
+    for (const BPlusLeaf* leaf = first; leaf; leaf = leaf->next) {
+        for (int i = 0; i < leaf->count; ++i) {
+            out.put(' ');
+            out.writeNumber(leaf->keys[i]);
+        }
+    }
+}
+
+void BPlusTree::deserializeFrom(std::string_view data) {
+    // data expected like: B <name> <count> <vals...>
+    TextReader in(data);
+    in.next(); // B
+    name = std::string(in.next());
+    std::uint64_t count = in.nextNumber<std::uint64_t>();
+    std::vector<int> keys;
+    keys.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(count, data.size() / 2 + 1)));
+    for (std::uint64_t i = 0; i < count; ++i) {
+        keys.push_back(in.nextNumber<int>());
+    }
+    buildBPlusFromSorted(this, keys.data(), keys.size());
+}
+
+void BPlusTree::serializeBinary(std::string& out) const {
+    appendU64(out, size);
+    out.reserve(out.size() + size * sizeof(std::int32_t));
+    for (const BPlusLeaf* leaf = first; leaf; leaf = leaf->next) {
+        for (int i = 0; i < leaf->count; ++i) appendI32(out, leaf->keys[i]);
+    }
+}
+
+void BPlusTree::deserializeBinary(const char* data, std::size_t size) {
+    BinaryReader in(data, size);
+    std::uint64_t count = in.readU64();
+    if (count > size / sizeof(std::int32_t)) throw std::runtime_error("Truncated binary snapshot");
+    std::vector<int> keys(static_cast<std::size_t>(count));
+    for (int& key : keys) key = in.readI32();
+    buildBPlusFromSorted(this, keys.data(), keys.size());
+}
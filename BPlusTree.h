@@ -0,0 +1,277 @@
+#ifndef BPLUS_TREE_H
+#define BPLUS_TREE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Structure.h"
+
+/**
+ * @brief Максимальное число ключей в узле B+дерева.
+ *
+ * Лист из 64 ключей int32 занимает 256 байт - четыре строки кэша, которые
+ * читаются подряд, вместо цепочки зависимых промахов по узлам BNode.
+ */
+constexpr int BPLUS_ORDER = 64;
+
+/** @brief Минимальное заполнение узла (кроме корня), ниже которого узел сливается с соседом */
+constexpr int BPLUS_MIN_KEYS = BPLUS_ORDER / 2;
+
+/**
+ * @brief Общий заголовок узла B+дерева.
+ *
+ * Узел - либо лист (BPlusLeaf), либо внутренний узел (BPlusInner);
+ * тип определяется полем leaf, удалять узел нужно через указатель своего типа.
+ */
+struct BPlusNode {
+    /** @brief Узел является листом */
+    bool leaf = false;
+    /** @brief Количество ключей в узле */
+    int count = 0;
+};
+
+/**
+ * @brief Лист B+дерева: отсортированные ключи и ссылки на соседние листья.
+ *
+ * Листья связаны в двусвязный список по возрастанию ключей, поэтому обход
+ * диапазона и поиск соседнего ключа не поднимаются к корню.
+ */
+struct BPlusLeaf : BPlusNode {
+    BPlusLeaf() { leaf = true; }
+    /** @brief Ключи по возрастанию */
+    int keys[BPLUS_ORDER];
+    /** @brief Предыдущий лист (nullptr для первого) */
+    BPlusLeaf* prev = nullptr;
+    /** @brief Следующий лист (nullptr для последнего) */
+    BPlusLeaf* next = nullptr;
+};
+
+/**
+ * @brief Внутренний узел B+дерева: count разделителей и count + 1 потомков.
+ *
+ * Поддерево children[i] содержит ключи из [keys[i - 1], keys[i]).
+ */
+struct BPlusInner : BPlusNode {
+    /** @brief Разделители по возрастанию */
+    int keys[BPLUS_ORDER];
+    /** @brief Потомки */
+    BPlusNode* children[BPLUS_ORDER + 1];
+    /** @brief Количество ключей в поддереве children[i] (для рангов и выборки по номеру) */
+    std::size_t sizes[BPLUS_ORDER + 1];
+};
+
+/**
+ * @brief B+дерево целочисленных ключей ("TCREATE name BPLUS").
+ *
+ * Альтернатива BTree для больших деревьев: широкие узлы (до BPLUS_ORDER ключей)
+ * дают высоту 3-4 на миллионах ключей, внутри узла ключ ищется бинарным поиском
+ * без ветвлений, а ключей на узел приходится в десятки раз больше, чем
+ * служебных указателей. Поддерживает те же команды TINSERT/TSEARCH/TDEL/TGET
+ * и TGETNODES, обход диапазона TRANGE по связанным листьям и порядковые
+ * запросы TRANK/TSELECT/TCOUNT по счетчикам ключей во внутренних узлах.
+ */
+struct BPlusTree;
+
+/**
+ * @brief Удаляет все узлы дерева (итеративно).
+ * @param tree Указатель на дерево
+ */
+void clearBPlusTree(BPlusTree* tree);
+
+struct BPlusTree : public Structure {
+    /** @brief Корень (nullptr если дерево пусто) */
+    BPlusNode* root = nullptr;
+    /** @brief Первый (самый левый) лист */
+    BPlusLeaf* first = nullptr;
+    /** @brief Количество ключей */
+    std::size_t size = 0;
+
+    BPlusTree() = default;
+    ~BPlusTree() override { clearBPlusTree(this); }
+
+    /**
+     * @brief Сериализует дерево в формат: "B name count key1 key2 ..."
+     *
+     * Ключи идут по возрастанию (обход связанных листьев).
+     * @param out Буфер записи, в который дописывается строка
+     */
+    void serializeTo(Writer& out) const override;
+
+    /**
+     * @brief Десериализует дерево из строки формата "B name count key1 key2 ..."
+     *
+     * Отсортированные ключи загружаются снизу вверх за O(n) (см. buildBPlusFromSorted()).
+     * @param data Строка с сохраненными данными дерева
+     */
+    void deserializeFrom(std::string_view data) override;
+
+    /**
+     * @brief Записывает дерево в бинарной форме: uint64 count, затем ключи int32 по возрастанию
+     * @param out Буфер для дописывания данных
+     */
+    void serializeBinary(std::string& out) const override;
+
+    /**
+     * @brief Восстанавливает дерево из бинарной формы
+     * @param data Начало полезной нагрузки
+     * @param size Длина полезной нагрузки в байтах
+     */
+    void deserializeBinary(const char* data, std::size_t size) override;
+};
+
+/**
+ * @brief Позиция ключа в листе B+дерева.
+ *
+ * leaf == nullptr означает позицию за последним ключом.
+ */
+struct BPlusCursor {
+    BPlusLeaf* leaf = nullptr;
+    int pos = 0;
+};
+
+/**
+ * @brief Добавляет ключ в дерево.
+ *
+ * Переполненный узел делится пополам, разделитель поднимается к родителю.
+ * При дописывании в конец последнего листа левая половина остается полной:
+ * возрастающие вставки заполняют листья целиком.
+ *
+ * @param tree Указатель на дерево
+ * @param key Ключ для вставки
+ * @throw std::runtime_error если ключ уже есть в дереве
+ */
+void insertKeyBPlus(BPlusTree* tree, int key);
+
+/**
+ * @brief Удаляет ключ из дерева.
+ *
+ * Узел, заполненный меньше чем на половину, занимает ключ у соседа
+ * или сливается с ним.
+ *
+ * @param tree Указатель на дерево
+ * @param key Ключ для удаления
+ * @throw std::runtime_error если ключ не найден
+ */
+void deleteKeyBPlus(BPlusTree* tree, int key);
+
+/**
+ * @brief Проверяет наличие ключа.
+ * @param tree Ссылка на дерево
+ * @param key Ключ для поиска
+ * @return true если ключ есть в дереве
+ */
+bool containsKeyBPlus(const BPlusTree& tree, int key);
+
+/**
+ * @brief Проверяет наличие пачки ключей за один проход (команда TMSEARCH).
+ *
+ * Ключи сортируются и ищутся по возрастанию: соседние ключи попадают в тот же
+ * или следующий лист, и спуск от корня повторяется только при скачке через
+ * несколько листьев.
+ *
+ * @param tree Ссылка на дерево
+ * @param keys Искомые ключи (в любом порядке, возможны повторы)
+ * @param found Результат: found[i] == 1 если keys[i] есть в дереве
+ */
+void containsKeysBPlus(const BPlusTree& tree, const std::vector<int>& keys, std::vector<char>& found);
+
+/**
+ * @brief Находит первый ключ, не меньший заданного.
+ * @param tree Ссылка на дерево
+ * @param key Граница поиска
+ * @return Позиция ключа (leaf == nullptr если все ключи меньше key)
+ */
+BPlusCursor lowerBoundBPlus(const BPlusTree& tree, int key);
+
+/**
+ * @brief Сдвигает позицию на следующий ключ по возрастанию.
+ * @param cursor Позиция (leaf != nullptr)
+ */
+inline void nextBPlus(BPlusCursor& cursor) {
+    if (++cursor.pos == cursor.leaf->count) {
+        cursor.leaf = cursor.leaf->next;
+        cursor.pos = 0;
+    }
+}
+
+/**
+ * @brief Сдвигает позицию на предыдущий ключ.
+ * @param cursor Позиция (leaf != nullptr); за первым ключом leaf становится nullptr
+ */
+inline void prevBPlus(BPlusCursor& cursor) {
+    if (cursor.pos-- == 0) {
+        cursor.leaf = cursor.leaf->prev;
+        cursor.pos = cursor.leaf ? cursor.leaf->count - 1 : 0;
+    }
+}
+
+/**
+ * @brief Вызывает fn(key) для всех ключей из [lo, hi] по возрастанию.
+ *
+ * Спуск к lo - O(log n), дальше ключи читаются подряд по связанным листьям.
+ *
+ * @param tree Ссылка на дерево
+ * @param lo Нижняя граница (включительно)
+ * @param hi Верхняя граница (включительно)
+ * @param fn Обработчик ключа
+ */
+template<typename Fn>
+void scanRangeBPlus(const BPlusTree& tree, int lo, int hi, Fn fn) {
+    if (lo > hi) return;
+    for (BPlusCursor c = lowerBoundBPlus(tree, lo); c.leaf; nextBPlus(c)) {
+        int key = c.leaf->keys[c.pos];
+        if (key > hi) break;
+        fn(key);
+    }
+}
+
+/**
+ * @brief Ранг ключа: количество ключей дерева, меньших key, за O(log n).
+ *
+ * Спуск суммирует счетчики BPlusInner::sizes потомков левее пути.
+ *
+ * @param tree Ссылка на дерево
+ * @param key Ключ (не обязан присутствовать в дереве)
+ * @return Количество ключей, меньших key
+ */
+std::size_t rankKeyBPlus(const BPlusTree& tree, int key);
+
+/**
+ * @brief k-й по возрастанию ключ (с нуля) за O(log n).
+ * @param tree Ссылка на дерево
+ * @param k Номер ключа
+ * @return Ключ
+ * @throw std::runtime_error если k >= tree.size
+ */
+int selectKeyBPlus(const BPlusTree& tree, std::size_t k);
+
+/**
+ * @brief Количество ключей из [lo, hi] за O(log n) (разность рангов).
+ * @param tree Ссылка на дерево
+ * @param lo Нижняя граница (включительно)
+ * @param hi Верхняя граница (включительно)
+ */
+std::size_t countRangeBPlus(const BPlusTree& tree, int lo, int hi);
+
+/**
+ * @brief Количество листьев B+дерева (узлов BPlusLeaf), обход списка листьев.
+ * @param tree Ссылка на дерево
+ */
+std::size_t leafCountBPlus(const BPlusTree& tree);
+
+/**
+ * @brief Строит дерево по отсортированным ключам за O(n).
+ *
+ * Листья заполняются подряд (равномерно, почти полностью), затем над ними
+ * уровень за уровнем строятся внутренние узлы. Если ключи не возрастают
+ * строго (файл правили вручную), они вставляются по одному.
+ *
+ * @param tree Указатель на дерево (прежнее содержимое удаляется)
+ * @param keys Ключи
+ * @param count Количество ключей
+ * @throw std::runtime_error если ключи повторяются
+ */
+void buildBPlusFromSorted(BPlusTree* tree, const int* keys, std::size_t count);
+
+#endif
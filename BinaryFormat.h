@@ -0,0 +1,122 @@
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Примитивы бинарного формата снимка базы данных.
+ *
+ * Все числа записываются в порядке байт платформы (little-endian на x86/ARM),
+ * строки - как длина (uint32) и байты без завершающего нуля.
+ * Полезная нагрузка структур:
+ *  - 'M', 'F', 'L', 'S', 'Q': uint64 count, затем count строк;
+ *         у 'F' и 'L' старший байт count - флаги списка (LIST_FLAG_INDEXED)
+ *  - 'T': uint64 count, затем count ключей в порядке pre-order;
+ *         старший байт count - флаги режима дерева (BTREE_FLAG_AVL, BTREE_FLAG_FROZEN)
+ *         и тип ключей
+ *         (BTREE_KEY_TYPE_MASK: 0 - int32, 1 - int64, 2 - строки)
+ *  - 'B': uint64 count, затем count ключей int32 по возрастанию
+ */
+
+/** @brief Флаг сбалансированного (AVL) дерева в старшем байте счетчика 'T' */
+constexpr std::uint64_t BTREE_FLAG_AVL = std::uint64_t(1) << 56;
+/** @brief Флаг замороженного дерева (массив Эйтцингера строится при загрузке) */
+constexpr std::uint64_t BTREE_FLAG_FROZEN = std::uint64_t(2) << 56;
+/** @brief Сдвиг кода типа ключей (TreeKeyType) в счетчике 'T' */
+constexpr int BTREE_KEY_TYPE_SHIFT = 58;
+/** @brief Маска кода типа ключей в счетчике 'T' (у записей int32 биты нулевые) */
+constexpr std::uint64_t BTREE_KEY_TYPE_MASK = std::uint64_t(3) << BTREE_KEY_TYPE_SHIFT;
+/** @brief Маска собственно количества ключей в счетчике 'T' */
+constexpr std::uint64_t BTREE_COUNT_MASK = (std::uint64_t(1) << 56) - 1;
+
+/** @brief Флаг списка с включенным индексом значений в старшем байте счетчика 'F'/'L' */
+constexpr std::uint64_t LIST_FLAG_INDEXED = std::uint64_t(1) << 56;
+/** @brief Маска собственно количества элементов в счетчике 'F'/'L' */
+constexpr std::uint64_t LIST_COUNT_MASK = (std::uint64_t(1) << 56) - 1;
+
+inline void appendU32(std::string& out, std::uint32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void appendU64(std::string& out, std::uint64_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void appendI32(std::string& out, std::int32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void appendI64(std::string& out, std::int64_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void appendString(std::string& out, std::string_view s) {
+    appendU32(out, static_cast<std::uint32_t>(s.size()));
+    out.append(s);
+}
+
+/**
+ * @brief Последовательное чтение бинарной полезной нагрузки без копирования буфера.
+ *
+ * Буфер (обычно отображенный через mmap файл) должен жить дольше читателя.
+ * При выходе за границы буфера бросает std::runtime_error.
+ */
+struct BinaryReader {
+    const char* cur;
+    const char* end;
+
+    BinaryReader(const char* data, std::size_t size) : cur(data), end(data + size) {}
+
+    void need(std::size_t n) const {
+        if (static_cast<std::size_t>(end - cur) < n) {
+            throw std::runtime_error("Truncated binary snapshot");
+        }
+    }
+
+    std::uint32_t readU32() {
+        std::uint32_t v;
+        need(sizeof(v));
+        std::memcpy(&v, cur, sizeof(v));
+        cur += sizeof(v);
+        return v;
+    }
+
+    std::uint64_t readU64() {
+        std::uint64_t v;
+        need(sizeof(v));
+        std::memcpy(&v, cur, sizeof(v));
+        cur += sizeof(v);
+        return v;
+    }
+
+    std::int32_t readI32() {
+        std::int32_t v;
+        need(sizeof(v));
+        std::memcpy(&v, cur, sizeof(v));
+        cur += sizeof(v);
+        return v;
+    }
+
+    std::int64_t readI64() {
+        std::int64_t v;
+        need(sizeof(v));
+        std::memcpy(&v, cur, sizeof(v));
+        cur += sizeof(v);
+        return v;
+    }
+
+    std::string readString() {
+        std::uint32_t len = readU32();
+        need(len);
+        std::string s(cur, len);
+        cur += len;
+        return s;
+    }
+};
+
+#endif
@@ -1,5 +1,5 @@
 #include "DoubleList.h"
-#include <sstream>
+#include "BinaryFormat.h"
 
 using namespace std;
 
@@ -12,15 +12,111 @@ DFList* createDFList() {
 }
 
 void deleteListDFList(DFList* list) {
-    if (!list) return;
-    
+    // Узлы вместе с блоками пула освобождает деструктор списка
+    delete list;
+}
+
+// Узлы создаются и освобождаются только здесь: индексы видят каждое изменение
+
+// Создает узел key и вставляет его после prev (nullptr - в начало)
+static DFNode* insertDFNode(DFList* list, const string& key, DFNode* prev) {
+    DFNode* next = prev ? prev->next : list->head;
+    DFNode* node = list->nodes.create(key, next, prev, nullptr);
+    if (next) next->prev = node;
+    else list->tail = node;
+    if (prev) prev->next = node;
+    else list->head = node;
+    list->length++;
+    list->index.linked(node);
+    list->index.add(key, node);
+    list->positions.inserted(node);
+
+    DFFinger& f = list->finger;
+    if (f.node) {
+        if (!node->prev || node->next == f.node) ++f.index;
+        else if (node->next && node->prev != f.node) f.node = nullptr;
+    }
+    return node;
+}
+
+// Отцепляет узел от соседей и освобождает его
+static void unlinkDFNode(DFList* list, DFNode* node) {
+    list->positions.removed(node);
+
+    DFFinger& f = list->finger;
+    if (f.node == node) {
+        // finger переходит на соседа: следующий узел получит тот же номер
+        if (node->next) f.node = node->next;
+        else if (node->prev) f = DFFinger{f.index - 1, node->prev};
+        else f.node = nullptr;
+    } else if (f.node) {
+        if (!node->prev || node->next == f.node) --f.index;
+        else if (node->next && node->prev != f.node) f.node = nullptr;
+    }
+
+    if (node->prev) node->prev->next = node->next;
+    else list->head = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else list->tail = node->prev;
+    list->index.remove(node->key, node);
+    list->nodes.destroy(node);
+    list->length--;
+}
+
+// Строит индекс значений, если он включен и еще не построен
+static void ensureIndex(const DFList* list) {
+    ValueIndex<DFNode>& index = list->index;
+    if (!index.enabled || index.built || list->packed) return;
+    index.built = true;
+    index.entries.reserve(list->length);
+    index.label(list->head);
+    for (DFNode* node = list->head; node; node = node->next) index.add(node->key, node);
+}
+
+// Первый узел со значением key (узловое представление)
+static DFNode* findNode(const DFList* list, const string& key) {
+    ensureIndex(list);
+    if (list->index.built) {
+        ValueIndex<DFNode>::Entry* entry = list->index.find(key);
+        // Узел первого вхождения хранится в записи и при повторах значения
+        return entry ? entry->first() : nullptr;
+    }
     DFNode* current = list->head;
     while (current) {
-        DFNode* next = current->next;
-        delete current;
-        current = next;
+        if (current->key == key) return current;
+        current = current->next;
     }
-    delete list;
+    return nullptr;
+}
+
+/*
+ * Компактное представление. Каждая операция сначала проверяет packed:
+ * маленький список меняется внутри ListPack, а вставка, которая вывела бы
+ * его за пороги, сначала переносит элементы в узлы (unpack).
+ */
+static void unpack(DFList* list) {
+    ListPack pack = std::move(list->pack);
+    list->pack.clear();
+    list->packed = false;
+    list->length = 0;
+    pack.forEach([&](std::string_view key) { insertDFNode(list, string(key), list->tail); });
+}
+
+// Вставляет key перед элементом index в компактном представлении; false - список переведен в узлы
+static bool packInsert(DFList* list, std::size_t index, const string& key) {
+    if (!list->packed) return false;
+    if (!list->pack.accepts(key)) {
+        unpack(list);
+        return false;
+    }
+    list->pack.insert(index, key);
+    list->length++;
+    return true;
+}
+
+static void packErase(DFList* list, std::size_t index, std::size_t count = 1) {
+    list->pack.erase(index, count);
+    list->length -= count;
 }
 
 void validateIndex(const DFList* list, int index, bool allowEnd = false) {
@@ -30,22 +126,45 @@ void validateIndex(const DFList* list, int index, bool allowEnd = false) {
     }
 }
 
+// Дальше этого числа шагов от ближайшей точки узел ищется через позиционный индекс
+static const std::size_t DF_WALK_MAX = 32;
+
 DFNode* getNodeAt(const DFList* list, int index) {
     validateIndex(list, index, false);
-    
-    if (index <= static_cast<int>(list->length / 2)) {
-        DFNode* current = list->head;
-        for (int i = 0; i < index; i++) {
-            current = current->next;
+
+    // Ближайшая из точек head, tail и finger
+    std::size_t target = index;
+    DFNode* current = list->head;
+    std::size_t at = 0;
+    std::size_t distance = target;
+    if (list->length - 1 - target < distance) {
+        current = list->tail;
+        at = list->length - 1;
+        distance = at - target;
+    }
+    DFFinger& finger = list->finger;
+    if (finger.node) {
+        std::size_t d = target > finger.index ? target - finger.index : finger.index - target;
+        if (d < distance) {
+            current = finger.node;
+            at = finger.index;
+            distance = d;
         }
-        return current;
+    }
+
+    SkipIndex<DFNode>& positions = list->positions;
+    if (distance > DF_WALK_MAX && !positions.built() && list->length >= SkipIndex<DFNode>::MIN_WEIGHT) {
+        positions.build(list->head);
+    }
+    if (distance > DF_WALK_MAX && positions.built()) {
+        std::size_t offset = target;
+        current = positions.locate(list->head, offset);
     } else {
-        DFNode* current = list->tail;
-        for (int i = list->length - 1; i > index; i--) {
-            current = current->prev;
-        }
-        return current;
+        for (; at < target; ++at) current = current->next;
+        for (; at > target; --at) current = current->prev;
     }
+    finger = DFFinger{static_cast<std::size_t>(index), current};
+    return current;
 }
 
 void addNodeAfterDFList(DFList* list, const string& key, int index) {
@@ -56,30 +175,8 @@ void addNodeAfterDFList(DFList* list, const string& key, int index) {
         return;
     }
     
-    if (list->length == 0) {
-        addNodeHeadDFList(list, key);
-        return;
-    }
-    
-    DFNode* newNode = new DFNode{key, nullptr, nullptr};
-    
-    if (index == list->length - 1) {
-        newNode->prev = list->tail;
-        newNode->next = nullptr;
-        list->tail->next = newNode;
-        list->tail = newNode;
-    } else {
-        DFNode* current = getNodeAt(list, index);
-        newNode->next = current->next;
-        newNode->prev = current;
-        
-        if (current->next) {
-            current->next->prev = newNode;
-        }
-        current->next = newNode;
-    }
-    
-    list->length++;
+    if (packInsert(list, index + 1, key)) return;
+    insertDFNode(list, key, getNodeAt(list, index));
 }
 
 void addNodeBeforeDFList(DFList* list, const string& key, int index) {
@@ -87,46 +184,19 @@ void addNodeBeforeDFList(DFList* list, const string& key, int index) {
     
     if (index == 0) {
         addNodeHeadDFList(list, key);
-    } else {
-        DFNode* newNode = new DFNode{key, nullptr, nullptr};
-        DFNode* current = getNodeAt(list, index);
-        
-        newNode->prev = current->prev;
-        newNode->next = current;
-        
-        if (current->prev) {
-            current->prev->next = newNode;
-        } else {
-            list->head = newNode;
-        }
-        current->prev = newNode;
-        
-        list->length++;
+    } else if (!packInsert(list, index, key)) {
+        insertDFNode(list, key, getNodeAt(list, index)->prev);
     }
 }
 
 void addNodeHeadDFList(DFList* list, const string& key) {
-    DFNode* newNode = new DFNode{key, list->head, nullptr};
-    
-    if (list->head) {
-        list->head->prev = newNode;
-    } else {
-        list->tail = newNode;
-    }
-    list->head = newNode;
-    list->length++;
+    if (packInsert(list, 0, key)) return;
+    insertDFNode(list, key, nullptr);
 }
 
 void addNodeTailDFList(DFList* list, const string& key) {
-    DFNode* newNode = new DFNode{key, nullptr, list->tail};
-    
-    if (list->tail) {
-        list->tail->next = newNode;
-    } else {
-        list->head = newNode;
-    }
-    list->tail = newNode;
-    list->length++;
+    if (packInsert(list, list->length, key)) return;
+    insertDFNode(list, key, list->tail);
 }
 
 void deleteNodeAtDFList(DFList* list, int index) {
@@ -136,97 +206,62 @@ void deleteNodeAtDFList(DFList* list, int index) {
         deleteNodeHeadDFList(list);
     } else if (index == list->length - 1) {
         deleteNodeTailDFList(list);
+    } else if (list->packed) {
+        packErase(list, index);
     } else {
-        DFNode* toDelete = getNodeAt(list, index);
-        toDelete->prev->next = toDelete->next;
-        toDelete->next->prev = toDelete->prev;
-        delete toDelete;
-        list->length--;
+        unlinkDFNode(list, getNodeAt(list, index));
     }
 }
 
 void deleteNodeHeadDFList(DFList* list) {
-    if (!list->head) return;
-    
-    DFNode* toDelete = list->head;
-    list->head = toDelete->next;
-    
-    if (list->head) {
-        list->head->prev = nullptr;
-    } else {
-        list->tail = nullptr;
-    }
-    
-    delete toDelete;
-    list->length--;
+    if (list->length == 0) return;
+    if (list->packed) packErase(list, 0);
+    else unlinkDFNode(list, list->head);
 }
 
 void deleteNodeTailDFList(DFList* list) {
-    if (!list->tail) return;
-    
-    DFNode* toDelete = list->tail;
-    list->tail = toDelete->prev;
-    
-    if (list->tail) {
-        list->tail->next = nullptr;
-    } else {
-        list->head = nullptr;
-    }
-    
-    delete toDelete;
-    list->length--;
+    if (list->length == 0) return;
+    if (list->packed) packErase(list, list->length - 1);
+    else unlinkDFNode(list, list->tail);
 }
 
 void deleteNodeByValueDFList(DFList* list, const string& key) {
-    DFNode* current = list->head;
-    int index = 0;
-    
-    while (current) {
-        if (current->key == key) {
-            deleteNodeAtDFList(list, index);
-            return;
+    if (list->packed) {
+        std::size_t i = list->pack.find(key);
+        if (i == ListPack::npos) {
+            throw runtime_error("Ключ не найден");
         }
-        current = current->next;
-        index++;
+        packErase(list, i);
+        return;
+    }
+    DFNode* found = findNode(list, key);
+    if (!found) {
+        throw runtime_error("Ключ не найден");
     }
-    throw runtime_error("Ключ не найден");
+    unlinkDFNode(list, found);
 }
 
 void deleteNodesBeforeIndex(DFList* list, int index) {
-    if (!list->head) {
+    if (list->length == 0) {
         throw runtime_error("Список пустой");
     }
     if (index <= 0) return;
     if (index >= static_cast<int>(list->length)) {
-        // удаление всех узлов
-        DFNode* cur = list->head;
-        while (cur) {
-            DFNode* nxt = cur->next;
-            delete cur;
-            cur = nxt;
-        }
-        list->head = list->tail = nullptr;
-        list->length = 0;
+        clearDFList(list);
         return;
     }
 
     // удаление первых 'index' узлов
-    int toDelete = index;
-    DFNode* cur = list->head;
-    while (toDelete > 0 && cur) {
-        DFNode* nxt = cur->next;
-        delete cur;
-        cur = nxt;
-        toDelete--;
-        list->length--;
+    if (list->packed) {
+        packErase(list, 0, index);
+        return;
     }
-    list->head = cur;
-    if (list->head) list->head->prev = nullptr;
+    for (int i = 0; i < index; ++i) unlinkDFNode(list, list->head);
 }
 
 // Удаление всех узлов ПОСЛЕ указанного индекса (не включая сам узел с индексом)
 void deleteNodesAfterIndex(DFList* list, int index) {
-    if (!list->head) {
+    if (list->length == 0) {
         throw runtime_error("Список пустой");
     }
     if (index < 0) return;
@@ -235,26 +270,17 @@ void deleteNodesAfterIndex(DFList* list, int index) {
         return;
     }
 
-    // поиск узла по индексу
-    DFNode* cur = list->head;
-    for (int i = 0; i < index && cur; ++i) cur = cur->next;
-    if (!cur) return;
-
-    // удаление узлов после 'cur'
-    DFNode* toDel = cur->next;
-    while (toDel) {
-        DFNode* nxt = toDel->next;
-        delete toDel;
-        list->length--;
-        toDel = nxt;
+    // удаление узлов после 'index' с конца списка
+    if (list->packed) {
+        packErase(list, index + 1, list->length - index - 1);
+        return;
     }
-    cur->next = nullptr;
-    list->tail = cur;
+    for (int i = static_cast<int>(list->length) - 1; i > index; --i) unlinkDFNode(list, list->tail);
 }
 
 // Альтернативная версия: просто удаление головы без возврата значения
 void deleteHeadOnlyDFList(DFList* list) {
-    if (!list || !list->head) {
+    if (!list || list->length == 0) {
         throw runtime_error("Список пуст или не инициализирован");
     }
     
@@ -273,72 +299,62 @@ void deleteNodesFromTo(DFList* list, int start, int end) {
         return;
     }
     
-    // Получаем узел, предшествующий диапазону
-    DFNode* beforeStart = getNodeAt(list, start - 1);
-    
-    // Получаем узел, следующий за диапазоном
-    DFNode* afterEnd = (end == static_cast<int>(list->length) - 1) 
-        ? nullptr 
-        : getNodeAt(list, end + 1);
-    
-    // Удаляем узлы в диапазоне
-    DFNode* current = beforeStart->next;
-    int deleteCount = end - start + 1;
-    
-    while (deleteCount > 0 && current) {
-        DFNode* toDelete = current;
-        current = current->next;
-        delete toDelete;
-        deleteCount--;
-        list->length--;
+    if (list->packed) {
+        packErase(list, start, end - start + 1);
+        return;
     }
-    
-    // Связываем оставшиеся части списка
-    beforeStart->next = afterEnd;
-    if (afterEnd) {
-        afterEnd->prev = beforeStart;
-    } else {
-        list->tail = beforeStart;
+
+    // Получаем узел, предшествующий диапазону, и удаляем узлы после него
+    DFNode* beforeStart = getNodeAt(list, start - 1);
+    for (int deleteCount = end - start + 1; deleteCount > 0; --deleteCount) {
+        unlinkDFNode(list, beforeStart->next);
     }
 }
 
 // Функция очистки всего списка
 void clearDFList(DFList* list) {
-    deleteNodesBeforeIndex(list, list->length);
+    list->nodes.releaseAll(list->head);
+    list->index.invalidate();
+    list->positions.forget();
+    list->finger = DFFinger();
+    list->head = list->tail = nullptr;
+    list->length = 0;
+    list->pack.clear();
+    list->packed = true;
 }
 
-std::string DFList::serialize() const {
-    std::ostringstream oss;
-    oss << "L " << name << " " << length;
-    DFNode* cur = head;
-    while (cur) {
-        oss << " " << cur->key;
-        cur = cur->next;
-    }
-    return oss.str();
-}
-
-void DFList::deserialize(const std::string& data) {
-    std::istringstream iss(data);
-    std::string type;
-    iss >> type; // L
-    iss >> name;
-    int count = 0; iss >> count;
-    // clear
-    DFNode* cur = head;
-    while (cur) {
-        DFNode* nxt = cur->next;
-        delete cur;
-        cur = nxt;
-    }
-    head = tail = nullptr; length = 0;
-    for (int i = 0; i < count; ++i) {
-        std::string v; iss >> v;
-        addNodeTailDFList(this, v);
+void DFList::serializeTo(Writer& out) const {
+    out.write("L ");
+    out.write(name);
+    out.put(' ');
+    if (index.enabled) out.write("INDEXED ");
+    out.writeNumber(length);
+    forEachDFList(this, [&](std::string_view key) {
+        out.put(' ');
+        out.write(key);
+    });
+}
+
+void DFList::deserializeFrom(std::string_view data) {
+    TextReader in(data);
+    in.next(); // L
+    name = std::string(in.next());
+    TextReader probe = in;
+    bool indexed = probe.next() == "INDEXED";
+    if (indexed) in = probe;
+    std::uint64_t count = in.nextNumber<std::uint64_t>();
+    clearDFList(this);
+    setIndexDFList(this, indexed);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        addNodeTailDFList(this, std::string(in.next()));
     }
 }
 
 string getElementDFList(const DFList* list, int index) {
+    if (list->packed) {
+        validateIndex(list, index, false);
+        return string(list->pack.at(index));
+    }
     return getNodeAt(list, index)->key;
 }
 
@@ -348,13 +364,16 @@ string popElementDFList(DFList* list, int index) {
     return value;
 }
 
-DFNode* findNodeByValueDFList(const DFList* list, const string& key) {
-    DFNode* current = list->head;
-    while (current) {
-        if (current->key == key) return current;
-        current = current->next;
-    }
-    return nullptr;
+void setIndexDFList(DFList* list, bool enabled) {
+    list->index.invalidate();
+    list->index.enabled = enabled;
+}
+
+bool containsDFList(const DFList* list, const string& key) {
+    if (list->packed) return list->pack.find(key) != ListPack::npos;
+    ensureIndex(list);
+    if (list->index.built) return list->index.find(key) != nullptr;
+    return findNode(list, key) != nullptr;
 }
 
 bool isEmptyDFList(const DFList* list) {
@@ -364,3 +383,19 @@ bool isEmptyDFList(const DFList* list) {
 size_t getLengthDFList(const DFList* list) {
     return list->length;
 }
+
+void DFList::serializeBinary(std::string& out) const {
+    appendU64(out, length | (index.enabled ? LIST_FLAG_INDEXED : 0));
+    forEachDFList(this, [&](std::string_view key) { appendString(out, key); });
+}
+
+void DFList::deserializeBinary(const char* data, std::size_t size) {
+    BinaryReader in(data, size);
+    std::uint64_t count = in.readU64();
+    clearDFList(this);
+    setIndexDFList(this, (count & LIST_FLAG_INDEXED) != 0);
+    count &= LIST_COUNT_MASK;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        addNodeTailDFList(this, in.readString());
+    }
+}
@@ -4,7 +4,10 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include "SkipIndex.h"
 
 /**
  * @brief Узел двусвязного списка.
@@ -19,9 +22,36 @@ struct DFNode {
     DFNode* next = nullptr;
     /** @brief Указатель на предыдущий узел (nullptr если это первый узел) */
     DFNode* prev = nullptr;
+    /** @brief Верхние уровни позиционного индекса (nullptr если их нет) */
+    std::unique_ptr<SkipTower<DFNode>> tower;
+    /** @brief Метка порядка узла для индекса значений (действует, пока он построен) */
+    std::uint64_t order = 0;
 };
 
+/** @brief Число элементов узла для позиционного индекса */
+inline std::size_t skipWeight(const DFNode*) {
+    return 1;
+}
+
 #include "Structure.h"
+#include "NodePool.h"
+#include "ValueIndex.h"
+#include "ListPack.h"
+
+/**
+ * @brief Последний узел, найденный по номеру (finger).
+ *
+ * Поиск по номеру начинается от ближайшей из точек head, tail и finger,
+ * поэтому постраничный обход LGET 0, LGET 1, ... делает один шаг на
+ * запрос. Вставка и удаление узла сдвигают index, если по соседям узла
+ * видно, с какой стороны от finger он стоит, иначе finger сбрасывается.
+ */
+struct DFFinger {
+    /** @brief Номер узла node */
+    std::size_t index = 0;
+    /** @brief Узел с номером index (nullptr - finger не задан) */
+    DFNode* node = nullptr;
+};
 
 /**
  * @brief Реализация структуры "Двусвязный список".
@@ -30,41 +60,78 @@ struct DFNode {
  * Позволяет эффективно удалять элементы с конца за O(1) благодаря сохранению
  * указателя на tail и доступу к prev от конца.
  * Поддерживает вставку/удаление в любую позицию и удаление диапазонов.
+ * Узел по номеру у длинного списка находит позиционный индекс (SkipIndex)
+ * за O(log n).
+ *
+ * Маленький список хранится без узлов, одним буфером (ListPack), пока не
+ * превысит пороги listPackLimits(); тогда элементы переносятся в узлы, и
+ * дальше список живет в узловом представлении до очистки или перезагрузки.
  */
 struct DFList : public Structure {
+    /** @brief Список хранится в pack, а не в узлах (head и tail - nullptr) */
+    bool packed = true;
+    /** @brief Компактное представление маленького списка (см. ListPack) */
+    ListPack pack;
     /** @brief Указатель на первый узел списка */
     DFNode* head = nullptr;
     /** @brief Указатель на последний узел списка (для O(1) операций с конца) */
     DFNode* tail = nullptr;
     /** @brief Количество узлов в списке */
     std::size_t length = 0;
+    /** @brief Пул, из которого выделяются узлы списка */
+    NodePool<DFNode> nodes;
+    /** @brief Хеш-индекс значений для LSEARCH/LDELVAL (выключен по умолчанию, см. ValueIndex) */
+    mutable ValueIndex<DFNode> index;
+    /** @brief Позиционный индекс для LGET/LPUSH/LDEL по номеру (строится лениво) */
+    mutable SkipIndex<DFNode> positions;
+    /** @brief Последний узел, найденный по номеру (см. DFFinger) */
+    mutable DFFinger finger;
     
     DFList() = default;
-    ~DFList() override {
-        DFNode* current = head;
-        while (current) {
-            DFNode* next = current->next;
-            delete current;
-            current = next;
-        }
-        head = nullptr;
-        tail = nullptr;
-        length = 0;
-    }
+    ~DFList() override { nodes.releaseAll(head); }
     
     /**
-     * @brief Сериализует список в формат: "L name count elem1 elem2 ..."
-     * @return Строка с сохраненным состоянием списка (от head к tail)
+     * @brief Сериализует список в формат: "L name [INDEXED] count elem1 elem2 ..."
+     *
+     * INDEXED записывается, если для списка включен индекс значений.
+     * @param out Буфер записи, в который дописывается строка
      */
-    std::string serialize() const override;
+    void serializeTo(Writer& out) const override;
     
     /**
-     * @brief Десериализует список из строки формата "L name count elem1 elem2 ..."
+     * @brief Десериализует список из строки формата "L name [INDEXED] count elem1 elem2 ..."
      * @param data Строка с сохраненными данными списка
      */
-    void deserialize(const std::string& data) override;
+    void deserializeFrom(std::string_view data) override;
+
+    /**
+     * @brief Записывает список в бинарной форме: uint64 count (с флагом LIST_FLAG_INDEXED), затем элементы от head к tail
+     * @param out Буфер для дописывания данных
+     */
+    void serializeBinary(std::string& out) const override;
+
+    /**
+     * @brief Восстанавливает список из бинарной формы
+     * @param data Начало полезной нагрузки
+     * @param size Длина полезной нагрузки в байтах
+     */
+    void deserializeBinary(const char* data, std::size_t size) override;
 };
 
+/**
+ * @brief Вызывает fn(value) для всех элементов списка от head к tail.
+ * @param list Указатель на список
+ * @param fn Обработчик элемента (std::string_view)
+ */
+template<typename Fn>
+void forEachDFList(const DFList* list, Fn fn) {
+    if (list->packed) {
+        list->pack.forEach(fn);
+        return;
+    }
+    for (const DFNode* node = list->head; node; node = node->next) fn(std::string_view(node->key));
+}
+
 /**
  * @brief Создает новый пустой двусвязный список.
  * @return Указатель на новый список (выделенный в heap)
@@ -151,12 +218,21 @@ std::string getElementDFList(const DFList* list, int index);
 std::string popElementDFList(DFList* list, int index);
 
 /**
- * @brief Находит первый узел со значением key.
+ * @brief Включает или выключает хеш-индекс значений списка.
+ *
+ * Включенный индекс строится при первом поиске или удалении по значению.
+ * @param list Указатель на список
+ * @param enabled Включить (true) или выключить и освободить (false)
+ */
+void setIndexDFList(DFList* list, bool enabled);
+
+/**
+ * @brief Проверяет, есть ли в списке значение key (O(1) при включенном индексе).
  * @param list Указатель на список
  * @param key Значение для поиска
- * @return Указатель на найденный узел или nullptr если не найден
+ * @return true если значение есть в списке
  */
-DFNode* findNodeByValueDFList(const DFList* list, const std::string& key);
+bool containsDFList(const DFList* list, const std::string& key);
 
 /**
  * @brief Проверяет, пуст ли список.
@@ -195,7 +271,9 @@ void deleteNodesAfterIndex(DFList* list, int index);
 void deleteNodesFromTo(DFList* list, int start, int end);
 
 /**
- * @brief Очищает весь список, удаляя все узлы.
+ * @brief Очищает весь список, освобождая блоки пула целиком.
+ *
+ * Очищенный список снова хранится компактно (ListPack).
  * @param list Указатель на список
  */
 void clearDFList(DFList* list);
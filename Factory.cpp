@@ -5,6 +5,8 @@
 #include "Stack.h"
 #include "Queue.h"
 #include "FullBinaryTree.h"
+#include "BPlusTree.h"
+#include <stdexcept>
 
 Structure* createStructure(char type) {
     switch (type) {
@@ -14,6 +16,28 @@ Structure* createStructure(char type) {
         case 'S': return new Stack();
         case 'Q': return new Queue();
         case 'T': return new BTree();
+        case 'B': return new BPlusTree();
         default: return nullptr;
     }
 }
+
+Structure* createStructureForRecord(char type, std::string_view record, bool binary) {
+    // Тип ключей дерева записан в самой записи, а не в символе типа
+    if (type == 'T') {
+        return createTree(binary ? binaryTreeKeyType(record.data(), record.size()) : textTreeKeyType(record));
+    }
+    return createStructure(type);
+}
+
+char getStructureTypeChar(const Structure* structure) {
+    if (dynamic_cast<const Array*>(structure)) return 'M';
+    if (dynamic_cast<const ForwardList*>(structure)) return 'F';
+    if (dynamic_cast<const DFList*>(structure)) return 'L';
+    if (dynamic_cast<const Stack*>(structure)) return 'S';
+    if (dynamic_cast<const Queue*>(structure)) return 'Q';
+    if (dynamic_cast<const BTree*>(structure)) return 'T';
+    if (dynamic_cast<const BTree64*>(structure)) return 'T';
+    if (dynamic_cast<const StringBTree*>(structure)) return 'T';
+    if (dynamic_cast<const BPlusTree*>(structure)) return 'B';
+    throw std::invalid_argument("Unknown structure type");
+}
@@ -1,6 +1,8 @@
 #ifndef FACTORY_H
 #define FACTORY_H
 
+#include <string_view>
+
 #include "Structure.h"
 
 /**
@@ -24,12 +26,40 @@
  *  - 'L': DFList (двусвязный список) - LCREATE, LPUSH, LGET, ...
  *  - 'S': Stack (стек, адаптер над ForwardList) - SCREATE, SPUSH, SPOP, ...
  *  - 'Q': Queue (очередь, адаптер над ForwardList) - QCREATE, QPUSH, QPOP, ...
- *  - 'T': BTree (полное бинарное дерево) - TCREATE, TINSERT, TSEARCH, ...
+ *  - 'T': BTree (полное бинарное дерево) - TCREATE, TINSERT, TSEARCH, ...;
+ *         деревья ключей int64 и строк создает createStructureForRecord()
+ *  - 'B': BPlusTree (B+дерево) - TCREATE name BPLUS, далее те же команды T...
  * 
- * @param type Символ, обозначающий тип структуры ('M', 'F', 'L', 'S', 'Q', 'T')
+ * @param type Символ, обозначающий тип структуры ('M', 'F', 'L', 'S', 'Q', 'T', 'B')
  * @return Указатель на новую структуру (выделенную в heap, должна быть удалена вызывающей стороной)
  * @throw std::invalid_argument если тип неизвестен
  */
 Structure* createStructure(char type);
 
+/**
+ * @brief Создает пустую структуру для сохраненной записи.
+ *
+ * Для большинства типов достаточно символа; у дерева 'T' тип ключей (int32,
+ * int64 или строки) читается из самой записи: слово после имени в текстовой
+ * строке или флаги счетчика в бинарной полезной нагрузке.
+ *
+ * @param type Символ типа структуры
+ * @param record Текстовая строка записи или бинарная полезная нагрузка
+ * @param binary Запись в бинарном формате
+ * @return Указатель на новую структуру (nullptr если тип неизвестен)
+ */
+Structure* createStructureForRecord(char type, std::string_view record, bool binary);
+
+/**
+ * @brief Возвращает символьный код типа для существующей структуры.
+ *
+ * Обратная операция к createStructure(): createStructure(getStructureTypeChar(s))
+ * создает пустую структуру того же типа, что и s.
+ *
+ * @param structure Указатель на структуру
+ * @return Символ типа ('M', 'F', 'L', 'S', 'Q', 'T', 'B')
+ * @throw std::invalid_argument если тип структуры неизвестен фабрике
+ */
+char getStructureTypeChar(const Structure* structure);
+
 #endif
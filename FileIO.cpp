@@ -1,11 +1,25 @@
 #include "FileIO.h"
 #include "Factory.h"
+#include "BinaryFormat.h"
+#include "ThreadPool.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <functional>
 #include <vector>
 #include <map>
+#include <cstdio>
+#if !defined(_WIN32)
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#endif
+
+static const char BINARY_MAGIC[4] = {'A', 'B', 'D', 'B'};
+static const std::uint32_t BINARY_VERSION = 1;
+static const std::size_t BINARY_HEADER_SIZE = 32;
+// Размер буфера потока при сохранении снимка
+static const std::size_t SAVE_BUFFER_SIZE = 1 << 20;
 
 static bool dirExists(const std::string& path) {
     struct stat info;
@@ -144,19 +158,8 @@ void saveForwardListToFile(const std::string& filename, const ForwardList& list)
         throw std::runtime_error("Cannot open file for writing");
     }
 
-    int count = 0;
-    FNode* cur = list.head;
-    while (cur != nullptr) {
-        count++;
-        cur = cur->next;
-    }
-
-    file << "F list " << count;
-    cur = list.head;
-    while (cur != nullptr) {
-        file << " " << cur->key;
-        cur = cur->next;
-    }
+    file << "F list " << list.size;
+    forEachFL(&list, [&](std::string_view key) { file << " " << key; });
     file << std::endl;
     file.close();
 }
@@ -197,19 +200,8 @@ void saveDoubleListToFile(const std::string& filename, const DFList& list) {
         throw std::runtime_error("Cannot open file for writing");
     }
 
-    int count = 0;
-    DFNode* cur = list.head;
-    while (cur != nullptr) {
-        count++;
-        cur = cur->next;
-    }
-
-    file << "L dlist " << count;
-    cur = list.head;
-    while (cur != nullptr) {
-        file << " " << cur->key;
-        cur = cur->next;
-    }
+    file << "L dlist " << list.length;
+    forEachDFList(&list, [&](std::string_view key) { file << " " << key; });
     file << std::endl;
     file.close();
 }
@@ -250,19 +242,9 @@ void saveStackToFile(const std::string& filename, const Stack& mStack) {
         throw std::runtime_error("Cannot open file for writing");
     }
 
-    int count = 0;
-    if (mStack.list && mStack.list->head) {
-        FNode* cur = mStack.list->head;
-        while (cur) { count++; cur = cur->next; }
-    }
-
-    file << "S st " << count;
-    if (mStack.list && mStack.list->head) {
-        FNode* cur = mStack.list->head;
-        while (cur) {
-            file << " " << cur->key;
-            cur = cur->next;
-        }
+    file << "S st " << (mStack.list ? mStack.list->size : 0);
+    if (mStack.list) {
+        forEachFL(mStack.list, [&](std::string_view key) { file << " " << key; });
     }
     file << std::endl;
     file.close();
@@ -297,12 +279,8 @@ void saveQueueToFile(const std::string& filename, const Queue& mQueue) {
     }
 
     file << "Q qu " << mQueue.size;
-    if (mQueue.list && mQueue.list->head) {
-        FNode* cur = mQueue.list->head;
-        while (cur) {
-            file << " " << cur->key;
-            cur = cur->next;
-        }
+    if (mQueue.list) {
+        forEachFL(mQueue.list, [&](std::string_view key) { file << " " << key; });
     }
     file << std::endl;
     file.close();
@@ -336,29 +314,12 @@ void saveTreeToFile(const std::string& filename, const BTree& tree) {
         throw std::runtime_error("Cannot open file for writing");
     }
 
-    // Подсчитываем узлы
-    int count = 0;
-    std::function<void(BNode*)> countNodes = [&](BNode* node) {
-        if (node) {
-            count++;
-            countNodes(node->left);
-            countNodes(node->right);
-        }
-    };
-    countNodes(tree.root);
-
-    file << "T tree " << count;
-
-    // Pre-order: Root -> Left -> Right
-    std::function<void(BNode*)> preOrder = [&](BNode* node) {
-        if (node) {
-            file << " " << node->key;
-            preOrder(node->left);
-            preOrder(node->right);
-        }
-    };
-    preOrder(tree.root);
-    file << std::endl;
+    // Общий сериализатор: сохраняются и режимы дерева (AVL, заморозка)
+    {
+        Writer out(file);
+        tree.serializeTo(out);
+        out.put('\n');
+    }
     file.close();
 }
 
@@ -370,23 +331,17 @@ BTree* loadTreeFromFile(const std::string& filename) {
 
     std::string line;
     std::getline(file, line);
-    
-    std::istringstream iss(line);
-    std::string typeChar, name;
-    int count;
-    iss >> typeChar >> name >> count;
-    
-    if (typeChar != "T") {
+    if (line.compare(0, 2, "T ") != 0) {
         throw std::runtime_error("Not a tree file");
     }
 
+    // Разбор общий с загрузкой базы: режим AVL и форма дерева из pre-order за O(n)
     BTree* tree = new BTree;
-    
-    // Парсим значения в Pre-order (Root -> Left -> Right)
-    for (int i = 0; i < count; ++i) {
-        int key;
-        iss >> key;
-        addNode(tree, key);
+    try {
+        tree->deserialize(line);
+    } catch (...) {
+        delete tree;
+        throw;
     }
     
     file.close();
@@ -415,38 +370,543 @@ void* loadStructureFromFile(const std::string& filename, std::string& type) {
     }
 }
 
-// New: load entire database from file (one structure per line)
-void loadDatabaseFromFile(const std::string& filename, std::map<std::string, Structure*>& database) {
-    std::ifstream file(filename);
-    if (!file.is_open()) return;
+// New: save entire database to file (overwrite)
+void saveDatabaseToFile(const std::string& filename, const std::map<std::string, Structure*>& database, std::uint64_t generation) {
+    saveDatabaseAtomically(filename, database, DatabaseFormat::Text, generation, nullptr);
+}
+
+// === BINARY SNAPSHOT ===
+DatabaseFormat detectDatabaseFormat(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(BINARY_MAGIC)] = {};
+    if (!file.read(magic, sizeof(magic))) return DatabaseFormat::Text;
+    return std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0 ? DatabaseFormat::Binary : DatabaseFormat::Text;
+}
+
+MappedFile::MappedFile(const std::string& filename) {
+#if defined(_WIN32)
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Cannot open file");
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open file");
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file");
+    }
+    size = static_cast<std::size_t>(info.st_size);
+    if (size > 0) {
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map file");
+        }
+        data = static_cast<const char*>(addr);
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+    if (data) munmap(const_cast<char*>(data), size);
+#endif
+}
+
+// Разбирает заголовок и каталог бинарного снимка
+static void readBinaryDirectory(const MappedFile& file, std::map<std::string, IndexEntry>& entries) {
+    if (file.size < BINARY_HEADER_SIZE || std::memcmp(file.data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) {
+        throw std::runtime_error("Not a binary snapshot");
+    }
+
+    BinaryReader header(file.data + sizeof(BINARY_MAGIC), BINARY_HEADER_SIZE - sizeof(BINARY_MAGIC));
+    std::uint32_t version = header.readU32();
+    if (version != BINARY_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version: " + std::to_string(version));
+    }
+    std::uint64_t count = header.readU64();
+    std::uint64_t directoryOffset = header.readU64();
+    if (directoryOffset > file.size) {
+        throw std::runtime_error("Truncated binary snapshot");
+    }
+
+    BinaryReader dir(file.data + directoryOffset, file.size - directoryOffset);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        IndexEntry entry;
+        dir.need(1);
+        entry.type = *dir.cur++;
+        std::string name = dir.readString();
+        entry.offset = dir.readU64();
+        entry.length = dir.readU64();
+        if (entry.offset > file.size || entry.length > file.size - entry.offset) {
+            throw std::runtime_error("Truncated binary snapshot");
+        }
+        entries[name] = entry;
+    }
+}
+
+// Разбирает оглавление текстового файла ("#INDEX ..." ... "#END <offset>") в конце файла
+static bool readTextFooter(const MappedFile& file, std::map<std::string, IndexEntry>& entries) {
+    if (file.size == 0) return false;
+    std::size_t end = file.size;
+    if (file.data[end - 1] == '\n') --end;
+    std::size_t lineStart = end;
+    while (lineStart > 0 && file.data[lineStart - 1] != '\n') --lineStart;
+    std::string last(file.data + lineStart, end - lineStart);
+    if (last.compare(0, 5, "#END ") != 0) return false;
+
+    std::uint64_t footer = std::strtoull(last.c_str() + 5, nullptr, 10);
+    if (footer > lineStart || (footer > 0 && file.data[footer - 1] != '\n')) return false;
+    std::istringstream lines(std::string(file.data + footer, lineStart - footer));
     std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
+    while (std::getline(lines, line)) {
         std::istringstream iss(line);
-        char typeChar; iss >> typeChar;
-        std::string name; iss >> name;
-        // create object
-        Structure* obj = createStructure(typeChar);
-        if (!obj) continue;
-        obj->deserialize(line);
-        obj->name = name;
-        database[name] = obj;
+        std::string tag, name;
+        IndexEntry entry;
+        if (!(iss >> tag >> entry.type >> name >> entry.offset >> entry.length) || tag != "#INDEX" ||
+            entry.offset > file.size || entry.length > file.size - entry.offset) {
+            entries.clear();
+            return false;
+        }
+        entries[name] = entry;
     }
-    file.close();
+    return true;
 }
 
-// New: save entire database to file (overwrite)
-void saveDatabaseToFile(const std::string& filename, const std::map<std::string, Structure*>& database) {
+// Строит оглавление текстового файла проходом по строкам (без разбора значений)
+static void scanTextFile(const MappedFile& file, std::map<std::string, IndexEntry>& entries) {
+    std::size_t pos = 0;
+    while (pos < file.size) {
+        const char* lineStart = file.data + pos;
+        const char* nl = static_cast<const char*>(std::memchr(lineStart, '\n', file.size - pos));
+        std::size_t len = nl ? static_cast<std::size_t>(nl - lineStart) : file.size - pos;
+        if (len > 0 && lineStart[0] != '#') {
+            TextReader in(std::string_view(lineStart, len));
+            IndexEntry entry;
+            entry.type = in.next()[0];
+            entry.offset = pos;
+            entry.length = len;
+            entries[std::string(in.next())] = entry;
+        }
+        pos += len + 1;
+    }
+}
+
+void loadDatabaseIndex(const std::string& filename, DatabaseIndex& index, bool trustFooter) {
+    index.entries.clear();
+    index.file.reset();
+    index.format = detectDatabaseFormat(filename);
+    index.generation = readDatabaseGeneration(filename);
+    if (!fileExists(filename)) return;
+
+    index.file = std::make_shared<MappedFile>(filename);
+    if (index.format == DatabaseFormat::Binary) {
+        readBinaryDirectory(*index.file, index.entries);
+    } else if (!trustFooter || !readTextFooter(*index.file, index.entries)) {
+        scanTextFile(*index.file, index.entries);
+    }
+}
+
+Structure* loadIndexedStructure(const DatabaseIndex& index, const std::string& name) {
+    auto it = index.entries.find(name);
+    if (it == index.entries.end() || !index.file) return nullptr;
+    const IndexEntry& entry = it->second;
+    const char* data = index.file->data + entry.offset;
+
+    if (index.format == DatabaseFormat::Text) {
+        // Оглавление могло устареть (например, файл правили вручную): строка должна начинаться с "<type> <name>"
+        std::string prefix = std::string(1, entry.type) + " " + name;
+        if (entry.length < prefix.size() || std::memcmp(data, prefix.data(), prefix.size()) != 0 ||
+            (entry.length > prefix.size() && data[prefix.size()] != ' ')) {
+            throw std::runtime_error("Stale database index");
+        }
+    }
+
+    Structure* obj = createStructureForRecord(entry.type, std::string_view(data, entry.length),
+                                              index.format == DatabaseFormat::Binary);
+    if (!obj) return nullptr;
+    try {
+        if (index.format == DatabaseFormat::Binary) obj->deserializeBinary(data, entry.length);
+        else obj->deserializeFrom(std::string_view(data, entry.length));
+    } catch (...) {
+        delete obj;
+        throw;
+    }
+    obj->name = name;
+    return obj;
+}
+
+/**
+ * Обходит базу в порядке имен, объединяя загруженные структуры и нетронутые
+ * записи исходного файла. Для каждой структуры вызывается ровно один из
+ * обработчиков: onLoaded(name, obj) или onUntouched(name, entry).
+ * Загруженная, но не измененная структура при совпадении формата тоже
+ * считается нетронутой - ее запись копируется из файла.
+ */
+template<typename OnLoaded, typename OnUntouched>
+static void forEachStructure(const std::map<std::string, Structure*>& database, const DatabaseIndex* untouched,
+                             DatabaseFormat format, OnLoaded onLoaded, OnUntouched onUntouched) {
+    static const std::map<std::string, IndexEntry> noEntries;
+    const std::map<std::string, IndexEntry>& entries = untouched ? untouched->entries : noEntries;
+    auto it = database.begin();
+    auto jt = entries.begin();
+    while (it != database.end() || jt != entries.end()) {
+        if (jt != entries.end() && (it == database.end() || jt->first < it->first)) {
+            onUntouched(jt->first, jt->second);
+            ++jt;
+            continue;
+        }
+        // Измененная структура заменяет одноименную запись файла
+        if (jt != entries.end() && jt->first == it->first) {
+            bool splice = it->second && !it->second->dirty && untouched->format == format;
+            if (splice) onUntouched(jt->first, jt->second);
+            ++jt;
+            if (splice) { ++it; continue; }
+        }
+        if (it->second) onLoaded(it->first, it->second);
+        ++it;
+    }
+}
+
+/**
+ * Одна запись сохраняемой базы: структура в памяти, которую нужно
+ * сериализовать заново, или запись исходного файла. Запись файла другого
+ * формата побайтно скопировать нельзя - она загружается временно и тоже
+ * сериализуется.
+ */
+struct PendingRecord {
+    const std::string* name = nullptr;
+    Structure* obj = nullptr;
+    const IndexEntry* entry = nullptr;
+    bool serialize = false;
+    // Запись, заранее сериализованная параллельно (ready == true)
+    bool ready = false;
+    char type = 0;
+    std::string buffer;
+};
+
+static std::vector<PendingRecord> collectRecords(const std::map<std::string, Structure*>& database,
+                                                 const DatabaseIndex* untouched, DatabaseFormat format) {
+    std::vector<PendingRecord> records;
+    forEachStructure(database, untouched, format,
+        [&](const std::string& name, Structure* obj) {
+            PendingRecord r;
+            r.name = &name;
+            r.obj = obj;
+            r.serialize = true;
+            records.push_back(std::move(r));
+        },
+        [&](const std::string& name, const IndexEntry& entry) {
+            PendingRecord r;
+            r.name = &name;
+            r.entry = &entry;
+            r.serialize = untouched->format != format;
+            records.push_back(std::move(r));
+        });
+    return records;
+}
+
+/**
+ * Сериализует записи базы параллельно и передает их emit строго по порядку.
+ *
+ * Записи обрабатываются пачками: записи пачки, требующие сериализации,
+ * готовятся на пуле потоков в собственных буферах (prepare), затем вся пачка
+ * отдается emit и буферы освобождаются - в памяти одновременно не больше
+ * нескольких записей на поток. Если сериализовать нужно не больше одной
+ * записи, пул не используется и emit получает неподготовленную запись.
+ */
+template<typename Prepare, typename Emit>
+static void writeRecords(std::vector<PendingRecord>& records, const DatabaseIndex* untouched,
+                         Prepare prepare, Emit emit) {
+    std::size_t pending = 0;
+    for (const PendingRecord& r : records) pending += r.serialize ? 1 : 0;
+    if (pending < 2) {
+        for (PendingRecord& r : records) emit(r);
+        return;
+    }
+
+    ThreadPool& pool = sharedThreadPool();
+    const std::size_t batchSize = pool.size() * 4;
+    std::vector<std::size_t> batch;
+    std::size_t first = 0;
+    while (first < records.size()) {
+        batch.clear();
+        std::size_t last = first;
+        while (last < records.size() && batch.size() < batchSize) {
+            if (records[last].serialize) batch.push_back(last);
+            ++last;
+        }
+        pool.parallelFor(batch.size(), [&](std::size_t k) {
+            PendingRecord& r = records[batch[k]];
+            Structure* temp = nullptr;
+            Structure* obj = r.obj;
+            if (!obj) {
+                temp = obj = loadIndexedStructure(*untouched, *r.name);
+                if (!obj) return;
+            }
+            try {
+                r.type = getStructureTypeChar(obj);
+                prepare(obj, r.buffer);
+            } catch (...) {
+                delete temp;
+                throw;
+            }
+            delete temp;
+            r.ready = true;
+        });
+        for (std::size_t i = first; i < last; ++i) {
+            // Запись, которой не оказалось в файле, пропускается
+            if (records[i].serialize && !records[i].ready) continue;
+            emit(records[i]);
+            std::string().swap(records[i].buffer);
+        }
+        first = last;
+    }
+}
+
+static void writeDatabaseBinary(std::ostream& out, const std::map<std::string, Structure*>& database,
+                                std::uint64_t generation, const DatabaseIndex* untouched) {
+    // Заголовок дописывается в конце, когда известно положение каталога
+    std::ostream::pos_type base = out.tellp();
+    std::string header(BINARY_HEADER_SIZE, '\0');
+    out.write(header.data(), header.size());
+
+    std::string directory;
+    std::string payload;
+    std::uint64_t offset = BINARY_HEADER_SIZE;
+    std::uint64_t count = 0;
+    auto addEntry = [&](const std::string& name, char type, const char* data, std::size_t length) {
+        out.write(data, length);
+        directory.push_back(type);
+        appendString(directory, name);
+        appendU64(directory, offset);
+        appendU64(directory, length);
+        offset += length;
+        ++count;
+    };
+    auto writeLoaded = [&](const std::string& name, Structure* obj) {
+        payload.clear();
+        obj->serializeBinary(payload);
+        addEntry(name, getStructureTypeChar(obj), payload.data(), payload.size());
+    };
+    std::vector<PendingRecord> records = collectRecords(database, untouched, DatabaseFormat::Binary);
+    writeRecords(records, untouched,
+        [](Structure* obj, std::string& buffer) { obj->serializeBinary(buffer); },
+        [&](PendingRecord& r) {
+            if (r.ready) {
+                addEntry(*r.name, r.type, r.buffer.data(), r.buffer.size());
+            } else if (r.obj) {
+                writeLoaded(*r.name, r.obj);
+            } else if (!r.serialize) {
+                addEntry(*r.name, r.entry->type, untouched->file->data + r.entry->offset, r.entry->length);
+            } else {
+                // Запись файла другого формата нельзя скопировать побайтно: загружаем ее временно
+                Structure* obj = loadIndexedStructure(*untouched, *r.name);
+                if (obj) writeLoaded(*r.name, obj);
+                delete obj;
+            }
+        });
+    out.write(directory.data(), directory.size());
+    std::ostream::pos_type endPos = out.tellp();
+
+    header.clear();
+    header.append(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    appendU32(header, BINARY_VERSION);
+    appendU64(header, count);
+    appendU64(header, offset);
+    appendU64(header, generation);
+    out.seekp(base);
+    out.write(header.data(), header.size());
+    out.seekp(endPos);
+}
+
+static void writeDatabaseText(std::ostream& out, const std::map<std::string, Structure*>& database,
+                              std::uint64_t generation, const DatabaseIndex* untouched) {
+    // Строки структур пишутся в поток порциями через общий буфер, без строки на структуру
+    Writer w(out);
+    if (generation > 0) {
+        w.write("#GEN ");
+        w.writeNumber(generation);
+        w.put('\n');
+    }
+
+    // Оглавление пишется в конец файла и позволяет загружать структуры по одной
+    std::string footer;
+    Writer f(footer);
+    auto addFooterEntry = [&](const std::string& name, char type, std::uint64_t offset, std::uint64_t length) {
+        f.write("#INDEX ");
+        f.put(type);
+        f.put(' ');
+        f.write(name);
+        f.put(' ');
+        f.writeNumber(offset);
+        f.put(' ');
+        f.writeNumber(length);
+        f.put('\n');
+    };
+    auto addEntry = [&](const std::string& name, char type, const char* data, std::size_t length) {
+        std::uint64_t offset = w.position();
+        w.write(data, length);
+        w.put('\n');
+        addFooterEntry(name, type, offset, length);
+    };
+    auto writeLoaded = [&](const std::string& name, Structure* obj) {
+        std::uint64_t offset = w.position();
+        obj->serializeTo(w);
+        std::uint64_t length = w.position() - offset;
+        w.put('\n');
+        addFooterEntry(name, getStructureTypeChar(obj), offset, length);
+    };
+    std::vector<PendingRecord> records = collectRecords(database, untouched, DatabaseFormat::Text);
+    writeRecords(records, untouched,
+        [](Structure* obj, std::string& buffer) {
+            Writer line(buffer);
+            obj->serializeTo(line);
+        },
+        [&](PendingRecord& r) {
+            if (r.ready) {
+                addEntry(*r.name, r.type, r.buffer.data(), r.buffer.size());
+            } else if (r.obj) {
+                writeLoaded(*r.name, r.obj);
+            } else if (!r.serialize) {
+                addEntry(*r.name, r.entry->type, untouched->file->data + r.entry->offset, r.entry->length);
+            } else {
+                // Запись файла другого формата нельзя скопировать побайтно: загружаем ее временно
+                Structure* obj = loadIndexedStructure(*untouched, *r.name);
+                if (obj) writeLoaded(*r.name, obj);
+                delete obj;
+            }
+        });
+    std::uint64_t footerOffset = w.position();
+    w.write(footer);
+    w.write("#END ");
+    w.writeNumber(footerOffset);
+    w.put('\n');
+    w.flush();
+}
+
+void writeDatabase(std::ostream& out, const std::map<std::string, Structure*>& database, DatabaseFormat format,
+                   std::uint64_t generation, const DatabaseIndex* untouched) {
+    if (format == DatabaseFormat::Binary) writeDatabaseBinary(out, database, generation, untouched);
+    else writeDatabaseText(out, database, generation, untouched);
+}
+
+std::uint64_t readDatabaseGeneration(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) return 0;
+    char header[BINARY_HEADER_SIZE] = {};
+    file.read(header, sizeof(header));
+    if (file.gcount() == static_cast<std::streamsize>(sizeof(header)) &&
+        std::memcmp(header, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+        BinaryReader in(header + 24, sizeof(std::uint64_t));
+        return in.readU64();
+    }
+    // Текстовый формат: необязательная первая строка "#GEN <n>"
+    file.clear();
+    file.seekg(0);
+    std::string line;
+    std::getline(file, line);
+    if (line.compare(0, 5, "#GEN ") != 0) return 0;
+    return std::strtoull(line.c_str() + 5, nullptr, 10);
+}
+
+void saveDatabaseToBinaryFile(const std::string& filename, const std::map<std::string, Structure*>& database, std::uint64_t generation) {
+    saveDatabaseAtomically(filename, database, DatabaseFormat::Binary, generation, nullptr);
+}
+
+void writeFileSynced(const std::string& filename, const std::string& data) {
     ensureDirectoryExists(filename);
-    std::ofstream file(filename, std::ios::out | std::ios::trunc);
-    if (!file.is_open()) return;
-    for (const auto& kv : database) {
-        Structure* obj = kv.second;
-        if (!obj) continue;
-        std::string line = obj->serialize();
-        file << line << std::endl;
+#if defined(_WIN32)
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("Cannot open file for writing");
+    file.write(data.data(), data.size());
+    file.flush();
+    if (!file) throw std::runtime_error("Cannot write file");
+#else
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot open file for writing");
+    const char* p = data.data();
+    std::size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            throw std::runtime_error("Cannot write file");
+        }
+        p += n;
+        left -= static_cast<std::size_t>(n);
     }
-    file.close();
+    if (fsync(fd) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot sync file");
+    }
+    close(fd);
+#endif
+}
+
+// Переименовывает записанный временный файл поверх filename
+static void replaceFile(const std::string& tmp, const std::string& filename) {
+#if defined(_WIN32)
+    std::remove(filename.c_str());
+#endif
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        throw std::runtime_error("Cannot replace file: " + filename);
+    }
+}
+
+// Сбрасывает на диск каталог файла: без этого переименование может не пережить сбой
+static void syncParentDirectory(const std::string& filename) {
+#if !defined(_WIN32)
+    std::size_t slash = filename.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : filename.substr(0, slash));
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+#else
+    (void)filename;
+#endif
+}
+
+void writeFileAtomically(const std::string& filename, const std::string& data) {
+    std::string tmp = filename + ".tmp";
+    writeFileSynced(tmp, data);
+    replaceFile(tmp, filename);
+    syncParentDirectory(filename);
+}
+
+void saveDatabaseAtomically(const std::string& filename, const std::map<std::string, Structure*>& database,
+                            DatabaseFormat format, std::uint64_t generation, const DatabaseIndex* untouched,
+                            bool sync) {
+    std::string tmp = filename + ".tmp";
+    ensureDirectoryExists(tmp);
+    {
+        // Буфер потока крупнее буфера Writer: данные уходят в ОС блоками по 1 МиБ
+        std::vector<char> buffer(SAVE_BUFFER_SIZE);
+        std::ofstream file;
+        file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        file.open(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) throw std::runtime_error("Cannot open file for writing");
+        writeDatabase(file, database, format, generation, untouched);
+        file.close();
+        if (!file) throw std::runtime_error("Cannot write file");
+    }
+#if !defined(_WIN32)
+    if (sync) {
+        int fd = open(tmp.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open file for sync");
+        int rc = fsync(fd);
+        close(fd);
+        if (rc != 0) throw std::runtime_error("Cannot sync file");
+    }
+#endif
+    replaceFile(tmp, filename);
+    if (sync) syncParentDirectory(filename);
 }
 
 void saveStructureToFile(const std::string& filename, const std::string& type, void* structure) {
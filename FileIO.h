@@ -1,5 +1,6 @@
 #ifndef FILEIO_H
 #define FILEIO_H
+#include <cstdint>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -19,6 +20,7 @@
 #include "FullBinaryTree.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include "Structure.h"
 
@@ -30,13 +32,94 @@
  *  - Операции на уровне базы данных (множество именованных структур)
  *  - Полиморфную сериализацию/десериализацию через базовый класс Structure
  * 
- * Формат файла:
+ * Текстовый формат файла:
  *  - Одна структура на одну строку
  *  - Формат: TYPE name count value1 value2 ...
  *  - Типы: 'M' (массив), 'F' (односвязный список), 'L' (двусвязный список),
  *           'S' (стек), 'Q' (очередь), 'T' (бинарное дерево)
+ *
+ * Бинарный формат файла (версия 1, определяется автоматически по сигнатуре):
+ *  - Заголовок 32 байта: "ABDB", uint32 version, uint64 count,
+ *    uint64 directoryOffset, uint64 reserved (поколение журнала мутаций)
+ *  - Полезные нагрузки структур подряд (см. BinaryFormat.h)
+ *  - Каталог из count записей: char type, uint32 nameLen, name,
+ *    uint64 payloadOffset, uint64 payloadLength
  */
 
+/**
+ * @brief Формат файла базы данных.
+ */
+enum class DatabaseFormat {
+    Text,
+    Binary
+};
+
+/**
+ * @brief Политика сброса данных на диск (fsync).
+ *
+ *  ALWAYS   - каждая фиксация (сохранение снимка, пачка команд журнала)
+ *             дожидается fsync
+ *  PERIODIC - журнал сбрасывается на диск не чаще раза в intervalMs мс;
+ *             при сбое ОС теряются изменения не старше интервала
+ *  NEVER    - данные передаются ОС, fsync не вызывается
+ *
+ * Запись в любом режиме атомарна: после сбоя на диске остается либо
+ * старый, либо новый снимок целиком.
+ */
+struct FsyncPolicy {
+    enum Mode { ALWAYS, PERIODIC, NEVER } mode = ALWAYS;
+    long intervalMs = 0;
+};
+
+/**
+ * @brief Файл, отображенный в память только для чтения.
+ *
+ * На платформах без mmap содержимое читается в буфер целиком.
+ * Отображение остается валидным и после замены файла на диске (rename),
+ * поэтому из него можно копировать данные при сохранении поверх того же пути.
+ */
+struct MappedFile {
+    const char* data = nullptr;
+    std::size_t size = 0;
+#if defined(_WIN32)
+    std::string buffer;
+#endif
+
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+/**
+ * @brief Положение одной структуры в файле базы данных.
+ *
+ * Для текстового формата - строка структуры (без '\n'), для бинарного -
+ * ее полезная нагрузка.
+ */
+struct IndexEntry {
+    char type = 0;
+    std::uint64_t offset = 0;
+    std::uint64_t length = 0;
+};
+
+/**
+ * @brief Оглавление файла базы данных: имя структуры -> ее положение в файле.
+ *
+ * Позволяет загружать только те структуры, к которым обращается команда,
+ * и копировать остальные при сохранении побайтно, без разбора.
+ * Текстовый файл хранит оглавление в конце ("#INDEX <type> <name> <offset> <length>"
+ * и последняя строка "#END <offset>"), бинарный - в каталоге снимка.
+ * Для текстовых файлов без оглавления оно строится проходом по строкам.
+ */
+struct DatabaseIndex {
+    DatabaseFormat format = DatabaseFormat::Text;
+    std::uint64_t generation = 0;
+    std::map<std::string, IndexEntry> entries;
+    /** @brief Отображение файла, из которого загружаются и копируются структуры */
+    std::shared_ptr<MappedFile> file;
+};
+
 /**
  * @brief Создает директорию для файла, если она не существует.
  * 
@@ -152,26 +235,121 @@ void saveTreeToFile(const std::string& filename, const BTree& tree);
 BTree* loadTreeFromFile(const std::string& filename);
 
 /**
- * @brief Загружает всю базу данных структур из файла (уровень базы данных).
+ * @brief Сохраняет всю базу данных структур в файл (уровень базы данных).
  * 
- * Читает файл и для каждой строки создает соответствующую структуру данных,
- * добавляя ее в map с ключом (именем структуры).
+ * Итерирует по всем структурам в map и сохраняет каждую,
+ * используя полиморфный метод serializeTo(). Файл заменяется атомарно
+ * (см. saveDatabaseAtomically()).
  * 
- * @param filename Путь к файлу с база данных структур
- * @param database Ссылка на map<name, Structure*> для заполнения
+ * @param filename Путь к файлу для сохранения
+ * @param database Ссылка на map<name, Structure*> для сохранения
+ * @param generation Поколение журнала мутаций, покрытое снимком (0 - журнал не используется)
  */
-void loadDatabaseFromFile(const std::string& filename, std::map<std::string, Structure*>& database);
+void saveDatabaseToFile(const std::string& filename, const std::map<std::string, Structure*>& database, std::uint64_t generation = 0);
 
 /**
- * @brief Сохраняет всю базу данных структур в файл (уровень базы данных).
- * 
- * Итерирует по всем структурам в map и сохраняет каждую,
- * используя полиморфный метод serialize().
- * 
+ * @brief Определяет формат файла базы данных по его первым байтам.
+ * @param filename Путь к файлу
+ * @return DatabaseFormat::Binary если файл начинается с сигнатуры бинарного снимка,
+ *         иначе DatabaseFormat::Text (в том числе для отсутствующего или пустого файла)
+ */
+DatabaseFormat detectDatabaseFormat(const std::string& filename);
+
+/**
+ * @brief Атомарно сохраняет базу данных в бинарный снимок (см. saveDatabaseAtomically()).
  * @param filename Путь к файлу для сохранения
  * @param database Ссылка на map<name, Structure*> для сохранения
+ * @param generation Поколение журнала мутаций, покрытое снимком (0 - журнал не используется)
+ */
+void saveDatabaseToBinaryFile(const std::string& filename, const std::map<std::string, Structure*>& database, std::uint64_t generation = 0);
+
+/**
+ * @brief Записывает базу данных в поток в заданном формате.
+ *
+ * Используется для сохранения в файл и для подготовки снимка в памяти
+ * (например, при уплотнении журнала мутаций).
+ *
+ * @param out Поток для записи (для бинарного формата должен поддерживать seekp)
+ * @param database Ссылка на map<name, Structure*> для сохранения
+ * @param format Формат записи
+ * @param generation Поколение журнала мутаций, покрытое снимком (0 - журнал не используется)
+ * @param untouched Оглавление исходного файла: его структуры, отсутствующие в database
+ *                  или не измененные (Structure::dirty == false), копируются в результат
+ *                  без разбора (nullptr - только database)
+ */
+void writeDatabase(std::ostream& out, const std::map<std::string, Structure*>& database, DatabaseFormat format,
+                   std::uint64_t generation = 0, const DatabaseIndex* untouched = nullptr);
+
+/**
+ * @brief Читает оглавление файла базы данных, не загружая сами структуры.
+ * @param filename Путь к файлу базы данных
+ * @param index Оглавление для заполнения (пустое, если файла нет)
+ * @param trustFooter false - игнорировать записанное оглавление текстового файла и построить его заново
+ * @throw std::runtime_error если бинарный снимок поврежден
+ */
+void loadDatabaseIndex(const std::string& filename, DatabaseIndex& index, bool trustFooter = true);
+
+/**
+ * @brief Загружает одну структуру по оглавлению.
+ * @param index Оглавление с открытым отображением файла
+ * @param name Имя структуры
+ * @return Новая структура (выделена в heap) или nullptr, если имени нет в оглавлении
+ * @throw std::runtime_error если оглавление не соответствует содержимому файла
+ */
+Structure* loadIndexedStructure(const DatabaseIndex& index, const std::string& name);
+
+/**
+ * @brief Читает поколение журнала мутаций, записанное в снимке.
+ *
+ * Текстовый снимок хранит его в необязательной первой строке "#GEN <n>"
+ * (строки, начинающиеся с '#', загрузчиком пропускаются), бинарный - в поле
+ * заголовка reserved.
+ *
+ * @param filename Путь к файлу снимка
+ * @return Поколение или 0, если файл отсутствует или поколение не записано
+ */
+std::uint64_t readDatabaseGeneration(const std::string& filename);
+
+/**
+ * @brief Записывает данные в файл и дожидается их сброса на диск (fsync).
+ * @param filename Путь к файлу (перезаписывается)
+ * @param data Содержимое файла
+ * @throw std::runtime_error при ошибке записи
+ */
+void writeFileSynced(const std::string& filename, const std::string& data);
+
+/**
+ * @brief Атомарно заменяет содержимое файла.
+ *
+ * Данные пишутся во временный файл "<filename>.tmp", сбрасываются на диск
+ * и переименовываются поверх filename. При сбое в любой момент на диске
+ * остается либо старое, либо новое содержимое целиком.
+ *
+ * @param filename Путь к файлу
+ * @param data Новое содержимое файла
+ * @throw std::runtime_error при ошибке записи
+ */
+void writeFileAtomically(const std::string& filename, const std::string& data);
+
+/**
+ * @brief Атомарно сохраняет базу данных в файл.
+ *
+ * Снимок пишется во временный файл "<filename>.tmp" потоково через
+ * writeDatabase() крупными блоками (целиком в памяти он не собирается),
+ * сбрасывается на диск и переименовывается поверх filename; затем
+ * сбрасывается каталог, чтобы переименование пережило сбой.
+ *
+ * @param filename Путь к файлу базы данных
+ * @param database Ссылка на map<name, Structure*> для сохранения
+ * @param format Формат записи
+ * @param generation Поколение журнала мутаций, покрытое снимком
+ * @param untouched Оглавление исходного файла (см. writeDatabase())
+ * @param sync false - не вызывать fsync (FsyncPolicy::NEVER)
+ * @throw std::runtime_error при ошибке записи
  */
-void saveDatabaseToFile(const std::string& filename, const std::map<std::string, Structure*>& database);
+void saveDatabaseAtomically(const std::string& filename, const std::map<std::string, Structure*>& database,
+                            DatabaseFormat format, std::uint64_t generation, const DatabaseIndex* untouched,
+                            bool sync = true);
 
 /**
  * @brief Загружает одну структуру из файла с определением типа.
@@ -1,6 +1,5 @@
-
 #include "ForwardList.h"
-#include <sstream>
+#include "BinaryFormat.h"
 using namespace std;
 
 ForwardList* createFL() {
@@ -12,17 +11,20 @@ ForwardList* createFL() {
 }
 
 void deleteFL(ForwardList* list) {
-    if (!list) return;
-    
-    FNode* current = list->head;
-    while (current) {
-        FNode* next = current->next;
-        delete current;
-        current = next;
-    }
+    // Узлы вместе с блоками пула освобождает деструктор списка
     delete list;
 }
 
+void clearFL(ForwardList* list) {
+    list->nodes.releaseAll(list->head);
+    list->index.invalidate();
+    list->positions.forget();
+    list->head = list->tail = nullptr;
+    list->size = 0;
+    list->pack.clear();
+    list->packed = true;
+}
+
 void validatePosition(const ForwardList* list, int position, bool allowEnd = false) {
     int maxPos = allowEnd ? list->size : list->size - 1;
     if (position < 0 || position > maxPos) {
@@ -30,35 +32,205 @@ void validatePosition(const ForwardList* list, int position, bool allowEnd = fal
     }
 }
 
-FNode* getNodeAt(const ForwardList* list, int position) {
-    validatePosition(list, position, false);
-    
-    FNode* current = list->head;
-    for (int i = 0; i < position; i++) {
-        current = current->next;
+/*
+ * Развернутые узлы. Элемент с номером index ищется переходами по узлам
+ * (index уменьшается на count узла), внутри узла - по смещению; у длинного
+ * списка узел находит позиционный индекс. Вставка в полный узел сначала
+ * делит его пополам; после удаления узел сливается с соседом, если вместе
+ * они заполнены не больше чем наполовину. Каждое изменение числа элементов
+ * узла и каждый вставленный или отцепленный узел сообщаются positions.
+ */
+
+// Позиция элемента: узел и номер элемента в узле
+struct FLPosition {
+    FNode* node;
+    int pos;
+};
+
+static FLPosition locate(const ForwardList* list, std::size_t index) {
+    SkipIndex<FNode>& positions = list->positions;
+    if (!positions.built() && list->size >= SkipIndex<FNode>::MIN_WEIGHT) positions.build(list->head);
+    if (positions.built()) {
+        FNode* node = positions.locate(list->head, index);
+        return FLPosition{node, static_cast<int>(index)};
+    }
+    FNode* node = list->head;
+    while (index >= static_cast<std::size_t>(node->count)) {
+        index -= node->count;
+        node = node->next;
     }
-    return current;
+    return FLPosition{node, static_cast<int>(index)};
 }
 
-void pushBackFL(ForwardList* list, const string& key) {
-    FNode* newNode = new FNode{key, nullptr};
-    
-    if (!list->head) {
-        list->head = list->tail = newNode;
+// Вставляет узел node в список после prev (nullptr - в начало)
+static void linkNode(ForwardList* list, FNode* node, FNode* prev) {
+    node->prev = prev;
+    node->next = prev ? prev->next : list->head;
+    if (node->next) node->next->prev = node;
+    else list->tail = node;
+    if (prev) prev->next = node;
+    else list->head = node;
+    list->positions.inserted(node);
+    list->index.linked(node);
+}
+
+// Переносит верхнюю половину элементов полного узла в новый узел после него
+static void splitNode(ForwardList* list, FNode* node) {
+    FNode* right = list->nodes.create();
+    int half = node->count / 2;
+    std::string* from = node->keys + node->first + node->count - half;
+    std::move(from, from + half, right->keys);
+    right->count = half;
+    node->count -= half;
+    list->positions.addWeight(node, -half);
+    linkNode(list, right, node);
+    if (list->index.built) {
+        for (int i = 0; i < half; ++i) list->index.moved(right->keys[i], node, right);
+    }
+}
+
+// Вставляет key перед элементом pos узла (pos == count - в конец узла)
+static void insertIntoNode(ForwardList* list, FNode* node, int pos, const string& key) {
+    if (node->count == FL_NODE_CAPACITY) {
+        splitNode(list, node);
+        if (pos > node->count) {
+            pos -= node->count;
+            node = node->next;
+        }
+    }
+    std::string* k = node->keys + node->first;
+    bool roomRight = node->first + node->count < FL_NODE_CAPACITY;
+    // Сдвигается меньшая часть узла, если с ее стороны есть место
+    if (roomRight && (node->first == 0 || pos >= node->count / 2)) {
+        std::move_backward(k + pos, k + node->count, k + node->count + 1);
+        k[pos] = key;
     } else {
-        list->tail->next = newNode;
-        list->tail = newNode;
+        std::move(k, k + pos, k - 1);
+        k[pos - 1] = key;
+        --node->first;
+    }
+    ++node->count;
+    ++list->size;
+    list->index.add(key, node);
+    list->positions.addWeight(node, 1);
+}
+
+static void unlinkNode(ForwardList* list, FNode* node) {
+    list->positions.removed(node);
+    if (node->prev) node->prev->next = node->next;
+    else list->head = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else list->tail = node->prev;
+    list->nodes.destroy(node);
+}
+
+// Дописывает элементы следующего узла в node и удаляет следующий узел
+static void mergeNext(ForwardList* list, FNode* node) {
+    FNode* next = node->next;
+    int moved = next->count;
+    if (node->first > 0) {
+        std::move(node->keys + node->first, node->keys + node->first + node->count, node->keys);
+        node->first = 0;
+    }
+    std::move(next->keys + next->first, next->keys + next->first + moved, node->keys + node->count);
+    if (list->index.built) {
+        for (int i = node->count; i < node->count + moved; ++i) list->index.moved(node->keys[i], next, node);
+    }
+    // Пока next в списке, его элементы учитываются в нем, затем переходят в node
+    unlinkNode(list, next);
+    node->count += moved;
+    list->positions.addWeight(node, moved);
+}
+
+static void eraseFromNode(ForwardList* list, FNode* node, int pos) {
+    std::string* k = node->keys + node->first;
+    list->index.remove(k[pos], node);
+    if (pos < node->count / 2) {
+        std::move_backward(k, k + pos, k + pos + 1);
+        std::string().swap(k[0]);
+        ++node->first;
+    } else {
+        std::move(k + pos + 1, k + node->count, k + pos);
+        std::string().swap(k[node->count - 1]);
+    }
+    --node->count;
+    --list->size;
+    list->positions.addWeight(node, -1);
+
+    // Соседние узлы вместе заполнены больше чем наполовину: узлов не больше n / 4 + 1
+    FNode* prev = node->prev;
+    if (node->count == 0) {
+        unlinkNode(list, node);
+        node = prev;
+    } else if (prev && prev->count + node->count <= FL_NODE_CAPACITY / 2) {
+        mergeNext(list, prev);
+        node = prev;
+    }
+    if (node && node->next && node->count + node->next->count <= FL_NODE_CAPACITY / 2) {
+        mergeNext(list, node);
+    }
+}
+
+/*
+ * Компактное представление. Каждая операция сначала проверяет packed:
+ * маленький список меняется внутри ListPack, а вставка, которая вывела бы
+ * его за пороги, сначала переносит элементы в узлы (unpack).
+ */
+static void unpack(ForwardList* list) {
+    ListPack pack = std::move(list->pack);
+    list->pack.clear();
+    list->packed = false;
+    list->size = 0;
+    pack.forEach([&](std::string_view key) { pushBackFL(list, std::string(key)); });
+}
+
+// Вставляет key перед элементом index в компактном представлении; false - список переведен в узлы
+static bool packInsert(ForwardList* list, std::size_t index, const string& key) {
+    if (!list->packed) return false;
+    if (!list->pack.accepts(key)) {
+        unpack(list);
+        return false;
+    }
+    list->pack.insert(index, key);
+    ++list->size;
+    return true;
+}
+
+static void packErase(ForwardList* list, std::size_t index) {
+    list->pack.erase(index);
+    --list->size;
+}
+
+void pushBackFL(ForwardList* list, const string& key) {
+    if (packInsert(list, list->size, key)) return;
+    FNode* tail = list->tail;
+    if (tail && tail->count < FL_NODE_CAPACITY) {
+        insertIntoNode(list, tail, tail->count, key);
+        return;
     }
+    // Новый узел заполняется с начала: следующие pushBack дописывают в него без сдвига
+    FNode* newNode = list->nodes.create();
+    newNode->keys[0] = key;
+    newNode->count = 1;
+    linkNode(list, newNode, tail);
+    list->index.add(key, newNode);
     list->size++;
 }
 
 void pushFrontFL(ForwardList* list, const string& key) {
-    FNode* newNode = new FNode{key, list->head};
-    
-    if (!list->head) {
-        list->tail = newNode;
+    if (packInsert(list, 0, key)) return;
+    FNode* head = list->head;
+    if (head && head->count < FL_NODE_CAPACITY) {
+        insertIntoNode(list, head, 0, key);
+        return;
     }
-    list->head = newNode;
+    // Новый узел заполняется с конца: следующие pushFront дописывают в него без сдвига
+    FNode* newNode = list->nodes.create();
+    newNode->first = FL_NODE_CAPACITY - 1;
+    newNode->keys[newNode->first] = key;
+    newNode->count = 1;
+    linkNode(list, newNode, nullptr);
+    list->index.add(key, newNode);
     list->size++;
 }
 
@@ -67,176 +239,210 @@ void insertBeforeFL(ForwardList* list, const string& key, int position) {
         pushFrontFL(list, key);
         return;
     }
-    
+
     validatePosition(list, position, false);
-    FNode* prev = getNodeAt(list, position - 1);
-    FNode* newNode = new FNode{key, prev->next};
-    prev->next = newNode;
-    
-    if (!newNode->next) {
-        list->tail = newNode;
-    }
-    list->size++;
+    if (packInsert(list, position, key)) return;
+    FLPosition at = locate(list, position);
+    insertIntoNode(list, at.node, at.pos, key);
 }
 
 void insertAfterFL(ForwardList* list, const string& key, int position) {
     validatePosition(list, position, false);
-    
+
     if (position == list->size - 1) {
         pushBackFL(list, key);
         return;
     }
-    
-    FNode* current = getNodeAt(list, position);
-    FNode* newNode = new FNode{key, current->next};
-    current->next = newNode;
-    list->size++;
+
+    if (packInsert(list, position + 1, key)) return;
+    FLPosition at = locate(list, position);
+    insertIntoNode(list, at.node, at.pos + 1, key);
 }
 
 void popFrontFL(ForwardList* list) {
-    if (!list->head) {
+    if (list->size == 0) {
         throw runtime_error("Список пустой");
     }
-    
-    FNode* temp = list->head;
-    list->head = list->head->next;
-    
-    if (!list->head) {
-        list->tail = nullptr;
+    if (list->packed) {
+        packErase(list, 0);
+        return;
     }
-    
-    delete temp;
-    list->size--;
+    eraseFromNode(list, list->head, 0);
 }
 
 void popBackFL(ForwardList* list) {
-    if (!list->head) {
+    if (list->size == 0) {
         throw runtime_error("Список пустой");
     }
-    
-    if (list->head == list->tail) {
-        delete list->head;
-        list->head = list->tail = nullptr;
-    } else {
-        FNode* current = list->head;
-        while (current->next != list->tail) {
-            current = current->next;
-        }
-        
-        delete list->tail;
-        current->next = nullptr;
-        list->tail = current;
+    if (list->packed) {
+        packErase(list, list->size - 1);
+        return;
     }
-    list->size--;
+    eraseFromNode(list, list->tail, list->tail->count - 1);
 }
 
-void removeAfterFL(ForwardList* list, FNode* prevNode) {
-    if (!prevNode || !prevNode->next) {
-        throw invalid_argument("Нода не имеет дочерней. Нечего удалять");
+void removeAtFL(ForwardList* list, size_t index) {
+    if (index >= list->size) {
+        throw out_of_range("Индекс за пределами списка");
+    }
+    if (list->packed) {
+        packErase(list, index);
+        return;
+    }
+    FLPosition at = locate(list, index);
+    eraseFromNode(list, at.node, at.pos);
+}
+
+// Строит индекс значений, если он включен и еще не построен
+static void ensureIndex(const ForwardList* list) {
+    ValueIndex<FNode>& index = list->index;
+    if (!index.enabled || index.built || list->packed) return;
+    index.built = true;
+    index.entries.reserve(list->size);
+    index.label(list->head);
+    for (FNode* node = list->head; node; node = node->next) {
+        for (int i = node->first, end = node->first + node->count; i < end; ++i) index.add(node->keys[i], node);
     }
-    
-    FNode* toDelete = prevNode->next;
-    prevNode->next = toDelete->next;
-    
-    if (toDelete == list->tail) {
-        list->tail = prevNode;
+}
+
+// Номер элемента value в узле node или -1
+static int findInNode(const FNode* node, const string& value) {
+    for (int i = 0; i < node->count; ++i) {
+        if (node->keys[node->first + i] == value) return i;
     }
-    
-    delete toDelete;
-    list->size--;
+    return -1;
+}
+
+void setIndexFL(ForwardList* list, bool enabled) {
+    list->index.invalidate();
+    list->index.enabled = enabled;
+}
+
+bool containsFL(const ForwardList* list, const string& value) {
+    ensureIndex(list);
+    if (list->index.built) return list->index.find(value) != nullptr;
+    return findByValueFL(list, value).data() != nullptr;
 }
 
 bool removeByValueFL(ForwardList* list, const string& value) {
-    if (!list->head) return false;
-    
-    if (list->head->key == value) {
-        popFrontFL(list);
+    if (list->packed) {
+        std::size_t i = list->pack.find(value);
+        if (i == ListPack::npos) return false;
+        packErase(list, i);
         return true;
     }
-    
-    FNode* current = list->head;
-    while (current->next && current->next->key != value) {
-        current = current->next;
-    }
-    
-    if (current->next) {
-        FNode* toDelete = current->next;
-        current->next = toDelete->next;
-        
-        if (toDelete == list->tail) {
-            list->tail = current;
-        }
-        
-        delete toDelete;
-        list->size--;
+    ensureIndex(list);
+    if (list->index.built) {
+        ValueIndex<FNode>::Entry* entry = list->index.find(value);
+        if (!entry) return false;
+        // Узел первого вхождения известен, проход не нужен
+        FNode* node = entry->first();
+        eraseFromNode(list, node, findInNode(node, value));
         return true;
     }
-    
+
+    for (FNode* node = list->head; node; node = node->next) {
+        int pos = findInNode(node, value);
+        if (pos >= 0) {
+            eraseFromNode(list, node, pos);
+            return true;
+        }
+    }
     return false;
 }
 
-FNode* findByValueFL(ForwardList* list, const string& value) {
-    FNode* current = list->head;
-    while (current) {
-        if (current->key == value) return current;
-        current = current->next;
+std::string_view findByValueFL(const ForwardList* list, const string& value) {
+    if (list->packed) {
+        std::size_t i = list->pack.find(value);
+        return i == ListPack::npos ? std::string_view() : list->pack.at(i);
+    }
+    ensureIndex(list);
+    if (list->index.built) {
+        ValueIndex<FNode>::Entry* entry = list->index.find(value);
+        if (!entry) return std::string_view();
+        const FNode* node = entry->first();
+        return node->keys[node->first + findInNode(node, value)];
     }
-    return nullptr;
+    for (const FNode* node = list->head; node; node = node->next) {
+        for (int i = node->first, end = node->first + node->count; i < end; ++i) {
+            if (node->keys[i] == value) return node->keys[i];
+        }
+    }
+    return std::string_view();
 }
 
 string frontFL(const ForwardList* list) {
-    if (!list->head) {
+    if (list->size == 0) {
         throw runtime_error("Список пустой");
     }
-    return list->head->key;
+    if (list->packed) return string(list->pack.at(0));
+    return list->head->keys[list->head->first];
 }
 
 string backFL(const ForwardList* list) {
-    if (!list->tail) {
+    if (list->size == 0) {
         throw runtime_error("Список пустой");
     }
-    return list->tail->key;
+    if (list->packed) return string(list->pack.at(list->size - 1));
+    return list->tail->keys[list->tail->first + list->tail->count - 1];
 }
 
 string getAtFL(const ForwardList* list, size_t index) {
-    return getNodeAt(list, index)->key;
+    if (index >= list->size) {
+        throw out_of_range("Индекс за пределами списка");
+    }
+    if (list->packed) return string(list->pack.at(index));
+    FLPosition at = locate(list, index);
+    return at.node->keys[at.node->first + at.pos];
 }
 
 bool isEmptyFL(const ForwardList* list) {
-    return !list->head;
+    return list->size == 0;
 }
 
 size_t getSizeFL(const ForwardList* list) {
     return list->size;
 }
 
-std::string ForwardList::serialize() const {
-    std::ostringstream oss;
-    oss << "F " << name << " " << size;
-    FNode* cur = head;
-    while (cur) {
-        oss << " " << cur->key;
-        cur = cur->next;
-    }
-    return oss.str();
-}
-
-void ForwardList::deserialize(const std::string& data) {
-    std::istringstream iss(data);
-    std::string type;
-    iss >> type; // F
-    iss >> name;
-    int count = 0; iss >> count;
-    // очистка
-    FNode* cur = head;
-    while (cur) {
-        FNode* nxt = cur->next;
-        delete cur;
-        cur = nxt;
-    }
-    head = tail = nullptr; size = 0;
-    for (int i = 0; i < count; ++i) {
-        std::string v; iss >> v;
-        pushBackFL(this, v);
-    }
-}
\ No newline at end of file
+void ForwardList::serializeTo(Writer& out) const {
+    out.write("F ");
+    out.write(name);
+    out.put(' ');
+    if (index.enabled) out.write("INDEXED ");
+    out.writeNumber(size);
+    forEachFL(this, [&](std::string_view key) {
+        out.put(' ');
+        out.write(key);
+    });
+}
+
+void ForwardList::deserializeFrom(std::string_view data) {
+    TextReader in(data);
+    in.next(); // F
+    name = std::string(in.next());
+    TextReader probe = in;
+    bool indexed = probe.next() == "INDEXED";
+    if (indexed) in = probe;
+    std::uint64_t count = in.nextNumber<std::uint64_t>();
+    clearFL(this);
+    setIndexFL(this, indexed);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        pushBackFL(this, std::string(in.next()));
+    }
+}
+
+void ForwardList::serializeBinary(std::string& out) const {
+    appendU64(out, size | (index.enabled ? LIST_FLAG_INDEXED : 0));
+    forEachFL(this, [&](std::string_view key) { appendString(out, key); });
+}
+
+void ForwardList::deserializeBinary(const char* data, std::size_t dataSize) {
+    BinaryReader in(data, dataSize);
+    std::uint64_t count = in.readU64();
+    clearFL(this);
+    setIndexFL(this, (count & LIST_FLAG_INDEXED) != 0);
+    count &= LIST_COUNT_MASK;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        pushBackFL(this, in.readString());
+    }
+}
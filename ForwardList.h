@@ -4,63 +4,135 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include "SkipIndex.h"
+
+/** @brief Емкость узла развернутого списка (элементов в одном FNode) */
+constexpr int FL_NODE_CAPACITY = 16;
 
 /**
- * @brief Узел односвязного списка.
+ * @brief Узел развернутого (unrolled) односвязного списка.
  *
- * Хранит строковое значение и указатель на следующий узел.
+ * Хранит до FL_NODE_CAPACITY строк подряд и ссылки на соседние узлы:
+ * обход и доступ по индексу переходят по ссылке раз на узел, а не на каждый
+ * элемент, и служебные байты (next, prev, first, count) делятся на весь узел.
+ * Обратная ссылка нужна позиционному индексу (SkipIndex) и удалению узла,
+ * найденного по значению, без прохода от head; снаружи список однонаправленный.
+ * Занята область keys[first, first + count); свободные места по краям
+ * позволяют добавлять в начало и в конец узла без сдвига.
+ * Пустых узлов в списке не бывает.
  */
 struct FNode {
-    /** @brief Ключ/значение, хранящееся в узле */
-    std::string key;
+    /** @brief Элементы узла */
+    std::string keys[FL_NODE_CAPACITY];
+    /** @brief Индекс первого элемента в keys */
+    int first = 0;
+    /** @brief Количество элементов в узле */
+    int count = 0;
     /** @brief Указатель на следующий узел (nullptr если это последний узел) */
     FNode* next = nullptr;
+    /** @brief Указатель на предыдущий узел (nullptr если это первый узел) */
+    FNode* prev = nullptr;
+    /** @brief Верхние уровни позиционного индекса (nullptr если их нет) */
+    std::unique_ptr<SkipTower<FNode>> tower;
+    /** @brief Метка порядка узла для индекса значений (действует, пока он построен) */
+    std::uint64_t order = 0;
 };
 
+/** @brief Число элементов узла для позиционного индекса */
+inline std::size_t skipWeight(const FNode* node) {
+    return static_cast<std::size_t>(node->count);
+}
+
 #include "Structure.h"
+#include "NodePool.h"
+#include "ValueIndex.h"
+#include "ListPack.h"
 
 /**
  * @brief Реализация структуры "Односвязный список".
  *
- * Список, в котором каждый узел содержит ссылку только на следующий узел.
+ * Список, элементы которого проходятся только от начала к концу.
  * Поддерживает вставку/удаление в начало, конец и по позиции.
  * Хранит оба указателя (head и tail) для оптимизации операций.
+ *
+ * Узлы развернутые (см. FNode): переполненный узел делится пополам, а узел,
+ * заполненный вместе со следующим не больше чем наполовину, сливается с ним,
+ * поэтому на n элементов приходится O(n / FL_NODE_CAPACITY) узлов.
+ * Доступ по номеру элемента у длинного списка идет через позиционный
+ * индекс (SkipIndex над узлами, span - число элементов) за O(log n).
+ *
+ * Маленький список хранится без узлов, одним буфером (ListPack), пока не
+ * превысит пороги listPackLimits(); тогда элементы переносятся в узлы, и
+ * дальше список живет в узловом представлении до очистки или перезагрузки.
  */
 struct ForwardList : public Structure {
+    /** @brief Список хранится в pack, а не в узлах (head и tail - nullptr) */
+    bool packed = true;
+    /** @brief Компактное представление маленького списка (см. ListPack) */
+    ListPack pack;
     /** @brief Указатель на первый узел списка */
     FNode* head = nullptr;
     /** @brief Указатель на последний узел списка (для O(1) вставки в конец) */
     FNode* tail = nullptr;
-    /** @brief Количество узлов в списке */
+    /** @brief Количество элементов в списке */
     std::size_t size = 0;
+    /** @brief Пул, из которого выделяются узлы списка */
+    NodePool<FNode> nodes;
+    /** @brief Хеш-индекс значений для FSEARCH/FDELVAL (выключен по умолчанию, см. ValueIndex) */
+    mutable ValueIndex<FNode> index;
+    /** @brief Позиционный индекс для FGET/FPUSH/FDEL по номеру (строится лениво) */
+    mutable SkipIndex<FNode> positions;
     
     ForwardList() = default;
-    ~ForwardList() override {
-        FNode* current = head;
-        while (current) {
-            FNode* next = current->next;
-            delete current;
-            current = next;
-        }
-        head = nullptr;
-        tail = nullptr;
-        size = 0;
-    }
+    ~ForwardList() override { nodes.releaseAll(head); }
     
     /**
-     * @brief Сериализует список в формат: "F name count elem1 elem2 ..."
-     * @return Строка с сохраненным состоянием списка (от head к tail)
+     * @brief Сериализует список в формат: "F name [INDEXED] count elem1 elem2 ..."
+     *
+     * INDEXED записывается, если для списка включен индекс значений.
+     * @param out Буфер записи, в который дописывается строка
      */
-    std::string serialize() const override;
+    void serializeTo(Writer& out) const override;
     
     /**
-     * @brief Десериализует список из строки формата "F name count elem1 elem2 ..."
+     * @brief Десериализует список из строки формата "F name [INDEXED] count elem1 elem2 ..."
      * @param data Строка с сохраненными данными списка
      */
-    void deserialize(const std::string& data) override;
+    void deserializeFrom(std::string_view data) override;
+
+    /**
+     * @brief Записывает список в бинарной форме: uint64 count (с флагом LIST_FLAG_INDEXED), затем элементы от head к tail
+     * @param out Буфер для дописывания данных
+     */
+    void serializeBinary(std::string& out) const override;
+
+    /**
+     * @brief Восстанавливает список из бинарной формы
+     * @param data Начало полезной нагрузки
+     * @param size Длина полезной нагрузки в байтах
+     */
+    void deserializeBinary(const char* data, std::size_t size) override;
 };
 
+/**
+ * @brief Вызывает fn(value) для всех элементов списка от head к tail.
+ * @param list Указатель на список
+ * @param fn Обработчик элемента (std::string_view)
+ */
+template<typename Fn>
+void forEachFL(const ForwardList* list, Fn fn) {
+    if (list->packed) {
+        list->pack.forEach(fn);
+        return;
+    }
+    for (const FNode* node = list->head; node; node = node->next) {
+        for (int i = node->first, end = node->first + node->count; i < end; ++i) fn(std::string_view(node->keys[i]));
+    }
+}
+
 /**
  * @brief Создает новый пустой односвязный список.
  * @return Указатель на новый список (выделенный в heap)
@@ -73,6 +145,14 @@ ForwardList* createFL();
  */
 void deleteFL(ForwardList* list);
 
+/**
+ * @brief Удаляет все элементы списка, освобождая блоки пула целиком.
+ *
+ * Очищенный список снова хранится компактно (ListPack).
+ * @param list Указатель на список
+ */
+void clearFL(ForwardList* list);
+
 /**
  * @brief Добавляет элемент в конец списка.
  * @param list Указатель на список
@@ -116,27 +196,45 @@ void popFrontFL(ForwardList* list);
 void popBackFL(ForwardList* list);
 
 /**
- * @brief Удаляет узел, который находится после prevNode.
+ * @brief Удаляет элемент на заданной позиции.
+ * @param list Указатель на список
+ * @param index Позиция элемента (0-based)
+ * @throw std::out_of_range если индекс вне границ
+ */
+void removeAtFL(ForwardList* list, std::size_t index);
+
+/**
+ * @brief Включает или выключает хеш-индекс значений списка.
+ *
+ * Включенный индекс строится при первом поиске или удалении по значению.
+ * @param list Указатель на список
+ * @param enabled Включить (true) или выключить и освободить (false)
+ */
+void setIndexFL(ForwardList* list, bool enabled);
+
+/**
+ * @brief Проверяет, есть ли в списке значение value (O(1) при включенном индексе).
  * @param list Указатель на список
- * @param prevNode Узел, после которого нужно удалить элемент
+ * @param value Значение для поиска
+ * @return true если значение есть в списке
  */
-void removeAfterFL(ForwardList* list, FNode* prevNode);
+bool containsFL(const ForwardList* list, const std::string& value);
 
 /**
- * @brief Удаляет первый узел со значением value.
+ * @brief Удаляет первый элемент со значением value.
  * @param list Указатель на список
  * @param value Значение для поиска и удаления
- * @return true если узел был найден и удален, false если узел не найден
+ * @return true если элемент был найден и удален, false если не найден
  */
 bool removeByValueFL(ForwardList* list, const std::string& value);
 
 /**
- * @brief Находит первый узел со значением value.
+ * @brief Находит первый элемент со значением value.
  * @param list Указатель на список
  * @param value Значение для поиска
- * @return Указатель на найденный узел или nullptr если не найден
+ * @return Найденный элемент (действителен до изменения списка); data() == nullptr, если не найден
  */
-FNode* findByValueFL(ForwardList* list, const std::string& value);
+std::string_view findByValueFL(const ForwardList* list, const std::string& value);
 
 /**
  * @brief Получает значение первого элемента списка.
@@ -173,7 +271,7 @@ bool isEmptyFL(const ForwardList* list);
 /**
  * @brief Возвращает количество элементов в списке.
  * @param list Указатель на список
- * @return Количество узлов
+ * @return Количество элементов
  */
 std::size_t getSizeFL(const ForwardList* list);
 
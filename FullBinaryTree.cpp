@@ -1,205 +1,815 @@
 #include "FullBinaryTree.h"
-#include <sstream>
-#include <functional>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "BinaryFormat.h"
 
-BNode* findPlaceNode(BNode* currentNode, int key) {
-    if (currentNode == nullptr) {
-        return nullptr;
-    }
-    if (currentNode->key > key) {
-        return currentNode->left == nullptr ? currentNode : findPlaceNode(currentNode->left, key);
-    }
-    if (currentNode->key < key) {
-        return currentNode->right == nullptr ? currentNode : findPlaceNode(currentNode->right, key);
+/*
+ * Все операции - шаблоны по типу ключа и сравнению; они определены здесь
+ * и явно инстанцируются в конце файла для BTree, BTree64 и StringBTree.
+ */
+
+template<typename Key, typename Compare>
+BNodeIndex findPlaceNode(const BasicTree<Key, Compare>& tree, BNodeIndex currentNode, const Key& key) {
+    using Tree = BasicTree<Key, Compare>;
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    while (currentNode != NO_NODE) {
+        const BasicNode<Key>& node = nodes[currentNode];
+        BNodeIndex next = Tree::less(key, node.key) ? node.left
+                        : Tree::less(node.key, key) ? node.right : NO_NODE;
+        if (next == NO_NODE) return currentNode;
+        currentNode = next;
     }
-    else {return currentNode;}
+    return NO_NODE;
+}
+
+// Высота и размер читаются без проверки на NO_NODE: у заглушки nodes[0] они нулевые
+template<typename Key, typename Compare>
+static int nodeHeight(const BasicTree<Key, Compare>& tree, BNodeIndex node) {
+    return tree.nodes[node].height;
+}
+
+template<typename Key, typename Compare>
+static std::size_t nodeSize(const BasicTree<Key, Compare>& tree, BNodeIndex node) {
+    return tree.nodes[node].size;
+}
+
+// Пересчитывает высоту и размер поддерева по потомкам
+template<typename Key, typename Compare>
+static void updateNode(BasicTree<Key, Compare>* tree, BNodeIndex index) {
+    BasicNode<Key>& node = tree->nodes[index];
+    node.height = 1 + std::max(nodeHeight(*tree, node.left), nodeHeight(*tree, node.right));
+    node.size = static_cast<std::uint32_t>(1 + nodeSize(*tree, node.left) + nodeSize(*tree, node.right));
+}
+
+// Количество потомков узла: индекс в BasicTree::nodesByChildren
+template<typename Key>
+static int childCount(const BasicNode<Key>& node) {
+    return (node.left != NO_NODE) + (node.right != NO_NODE);
 }
 
-void addNode(BTree* tree, int key) {
-    BNode* newNode = new BNode;
-    newNode->key = key;
-    if (tree->root == nullptr) {tree->root = newNode;}
-    else {
-        BNode* currentNode = findPlaceNode(tree->root, key);
-        if (currentNode->key == key) {throw std::runtime_error("Ключ уже существует в дереве");}
-        if (currentNode->key > key) {
-            currentNode->left = newNode;
-            newNode->parent = currentNode;
+// Снимают узел со счетчиков и возвращают на них (до и после изменения его потомков)
+template<typename Key, typename Compare>
+static void uncountNode(BasicTree<Key, Compare>* tree, BNodeIndex node) {
+    --tree->nodesByChildren[childCount(tree->nodes[node])];
+}
+
+template<typename Key, typename Compare>
+static void countNode(BasicTree<Key, Compare>* tree, BNodeIndex node) {
+    ++tree->nodesByChildren[childCount(tree->nodes[node])];
+}
+
+// Ставит child на место old у родителя old (или в корень)
+template<typename Key, typename Compare>
+static void replaceChild(BasicTree<Key, Compare>* tree, BNodeIndex old, BNodeIndex child) {
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    BNodeIndex parent = nodes[old].parent;
+    if (parent == NO_NODE) tree->root = child;
+    else if (nodes[parent].left == old) nodes[parent].left = child;
+    else nodes[parent].right = child;
+    if (child != NO_NODE) nodes[child].parent = parent;
+}
+
+// Малые повороты AVL; возвращают новый корень поддерева
+// Поворот меняет потомков только у x и y: счетчики правятся для них двоих
+template<typename Key, typename Compare>
+static BNodeIndex rotateLeft(BasicTree<Key, Compare>* tree, BNodeIndex x) {
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    BNodeIndex y = nodes[x].right;
+    uncountNode(tree, x);
+    uncountNode(tree, y);
+    nodes[x].right = nodes[y].left;
+    if (nodes[y].left != NO_NODE) nodes[nodes[y].left].parent = x;
+    replaceChild(tree, x, y);
+    nodes[y].left = x;
+    nodes[x].parent = y;
+    updateNode(tree, x);
+    updateNode(tree, y);
+    countNode(tree, x);
+    countNode(tree, y);
+    return y;
+}
+
+template<typename Key, typename Compare>
+static BNodeIndex rotateRight(BasicTree<Key, Compare>* tree, BNodeIndex x) {
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    BNodeIndex y = nodes[x].left;
+    uncountNode(tree, x);
+    uncountNode(tree, y);
+    nodes[x].left = nodes[y].right;
+    if (nodes[y].right != NO_NODE) nodes[nodes[y].right].parent = x;
+    replaceChild(tree, x, y);
+    nodes[y].right = x;
+    nodes[x].parent = y;
+    updateNode(tree, x);
+    updateNode(tree, y);
+    countNode(tree, x);
+    countNode(tree, y);
+    return y;
+}
+
+/**
+ * Поднимается от node к корню, пересчитывая высоты и размеры и выполняя повороты там,
+ * где разница высот поддеревьев превысила 1. Ссылки на родителей
+ * поворотами поддерживаются, поэтому поиск предшественника/преемника работает.
+ */
+template<typename Key, typename Compare>
+static void rebalanceFrom(BasicTree<Key, Compare>* tree, BNodeIndex node) {
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    while (node != NO_NODE) {
+        updateNode(tree, node);
+        BNodeIndex left = nodes[node].left;
+        BNodeIndex right = nodes[node].right;
+        int balance = nodeHeight(*tree, left) - nodeHeight(*tree, right);
+        if (balance > 1) {
+            if (nodeHeight(*tree, nodes[left].left) < nodeHeight(*tree, nodes[left].right)) rotateLeft(tree, left);
+            node = rotateRight(tree, node);
+        } else if (balance < -1) {
+            if (nodeHeight(*tree, nodes[right].right) < nodeHeight(*tree, nodes[right].left)) rotateRight(tree, right);
+            node = rotateLeft(tree, node);
         }
-        if (currentNode->key < key) {
-            currentNode->right = newNode;
-            newNode->parent = currentNode;
+        node = nodes[node].parent;
+    }
+}
+
+// Заглушка nodes[0]: нулевые высота и размер у отсутствующего поддерева
+template<typename Key>
+static BasicNode<Key> sentinelNode() {
+    BasicNode<Key> sentinel;
+    sentinel.height = 0;
+    sentinel.size = 0;
+    return sentinel;
+}
+
+template<typename Key, typename Compare>
+BNodeIndex allocateNode(BasicTree<Key, Compare>* tree, const Key& key) {
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    if (nodes.empty()) nodes.push_back(sentinelNode<Key>());
+    BNodeIndex index = tree->freeList;
+    if (index != NO_NODE) {
+        tree->freeList = nodes[index].left;
+        nodes[index] = BasicNode<Key>();
+    } else {
+        if (nodes.size() > std::numeric_limits<BNodeIndex>::max()) {
+            throw std::runtime_error("Превышено количество узлов дерева");
         }
+        index = static_cast<BNodeIndex>(nodes.size());
+        nodes.emplace_back();
+    }
+    nodes[index].key = key;
+    return index;
+}
+
+template<typename Key, typename Compare>
+void releaseNode(BasicTree<Key, Compare>* tree, BNodeIndex node) {
+    BasicNode<Key>& slot = tree->nodes[node];
+    slot = BasicNode<Key>();
+    slot.left = tree->freeList;
+    tree->freeList = node;
+}
+
+template<typename Key, typename Compare>
+void addNode(BasicTree<Key, Compare>* tree, const Key& key) {
+    using Tree = BasicTree<Key, Compare>;
+    thawTree(tree);
+    if (tree->root == NO_NODE) {
+        tree->root = allocateNode(tree, key);
+        countNode(tree, tree->root);
+        return;
+    }
+    BNodeIndex currentNode = findPlaceNode(*tree, tree->root, key);
+    if (Tree::equal(tree->nodes[currentNode].key, key)) {throw std::runtime_error("Ключ уже существует в дереве");}
+    // Арена может переехать при выделении: ссылки на узлы берутся после него
+    BNodeIndex newNode = allocateNode(tree, key);
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    uncountNode(tree, currentNode);
+    if (Tree::less(key, nodes[currentNode].key)) {
+        nodes[currentNode].left = newNode;
+    } else {
+        nodes[currentNode].right = newNode;
     }
+    nodes[newNode].parent = currentNode;
+    countNode(tree, currentNode);
+    countNode(tree, newNode);
+    // rebalanceFrom() пересчитывает размеры сам, поднимаясь до корня
+    if (tree->balanced) rebalanceFrom(tree, currentNode);
+    else for (BNodeIndex p = currentNode; p != NO_NODE; p = nodes[p].parent) ++nodes[p].size;
 }
 
-BNode* findNode(const BTree& tree, int key) {
-    if (tree.root == nullptr) {
+template<typename Key, typename Compare>
+BNodeIndex findNode(const BasicTree<Key, Compare>& tree, const Key& key) {
+    if (tree.root == NO_NODE) {
         throw std::runtime_error("Дерево пустое");
     }
-    BNode* currentNode = findPlaceNode(tree.root, key);
-    if (currentNode == nullptr || currentNode->key != key) {
+    BNodeIndex currentNode = findPlaceNode(tree, tree.root, key);
+    if (currentNode == NO_NODE || !BasicTree<Key, Compare>::equal(tree.nodes[currentNode].key, key)) {
         throw std::runtime_error("Ключ не найден в дереве");
     }
     return currentNode;
 }
 
-BNode* findMinNode(BNode* currentNode) {
-    return currentNode->left == nullptr ? currentNode : findMinNode(currentNode->left);
+template<typename Key, typename Compare>
+BNodeIndex findMinNode(const BasicTree<Key, Compare>& tree, BNodeIndex currentNode) {
+    while (tree.nodes[currentNode].left != NO_NODE) currentNode = tree.nodes[currentNode].left;
+    return currentNode;
 }
 
-BNode* findMaxNode(BNode* currentNode) {
-    return currentNode->right == nullptr ? currentNode : findMaxNode(currentNode->right);
+template<typename Key, typename Compare>
+BNodeIndex findMaxNode(const BasicTree<Key, Compare>& tree, BNodeIndex currentNode) {
+    while (tree.nodes[currentNode].right != NO_NODE) currentNode = tree.nodes[currentNode].right;
+    return currentNode;
 }
 
-BNode* findInOrderPredecessor(BNode* node) {
-    if (node->left != nullptr) {
-        return findMaxNode(node->left);
+template<typename Key, typename Compare>
+BNodeIndex findInOrderPredecessor(const BasicTree<Key, Compare>& tree, BNodeIndex node) {
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    if (nodes[node].left != NO_NODE) {
+        return findMaxNode(tree, nodes[node].left);
     }
-    BNode* successor = nullptr;
-    BNode* current = node;
-    
-    while (current->parent != nullptr) {
-        if (current->parent->right == current) {
-            successor = current->parent;
-            break;
-        }
-        current = current->parent;
+    // Поднимаемся, пока узел - левый потомок
+    BNodeIndex current = node;
+    while (nodes[current].parent != NO_NODE) {
+        BNodeIndex parent = nodes[current].parent;
+        if (nodes[parent].right == current) return parent;
+        current = parent;
     }
-    return successor;
+    return NO_NODE;
 }
 
-BNode* findInOrderSuccessor(BNode* node) {
-    if (node->right != nullptr) {
-        return findMinNode(node->right);
+template<typename Key, typename Compare>
+BNodeIndex findInOrderSuccessor(const BasicTree<Key, Compare>& tree, BNodeIndex node) {
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    if (nodes[node].right != NO_NODE) {
+        return findMinNode(tree, nodes[node].right);
     }
-    BNode* successor = nullptr;
-    BNode* current = node;
-    
-    while (current->parent != nullptr) {
-        if (current->parent->left == current) {
-            successor = current->parent;
-            break;
-        }
-        current = current->parent;
+    // Поднимаемся, пока узел - правый потомок
+    BNodeIndex current = node;
+    while (nodes[current].parent != NO_NODE) {
+        BNodeIndex parent = nodes[current].parent;
+        if (nodes[parent].left == current) return parent;
+        current = parent;
     }
-    return successor;
+    return NO_NODE;
 }
 
-void deleteNode(BTree* tree, int key) {
-    if (tree == nullptr || tree->root == nullptr) {
+template<typename Key, typename Compare>
+void deleteNode(BasicTree<Key, Compare>* tree, const Key& key) {
+    if (tree != nullptr) thawTree(tree);
+    if (tree == nullptr || tree->root == NO_NODE) {
         throw std::runtime_error("Дерево пустое");
     }
-    
-    BNode* currentNode = findNode(*tree, key);
-    
-    if (currentNode->left == nullptr && currentNode->right == nullptr) {
-        if (currentNode->parent != nullptr) {
-            if (currentNode->parent->left == currentNode) {
-                currentNode->parent->left = nullptr;
-            } else {
-                currentNode->parent->right = nullptr;
-            }
-        } else {
-            tree->root = nullptr;
-        }
-        delete currentNode;
+
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    BNodeIndex currentNode = findNode(*tree, key);
+    // Физически удаляется сам узел или (при двух потомках) его преемник;
+    // у родителя удаляемого меняются потомки, отсюда же восстанавливается баланс
+    BNodeIndex victim = (nodes[currentNode].left != NO_NODE && nodes[currentNode].right != NO_NODE)
+                        ? findMinNode(*tree, nodes[currentNode].right) : currentNode;
+    BNodeIndex fixFrom = nodes[victim].parent;
+    uncountNode(tree, victim);
+    if (fixFrom != NO_NODE) uncountNode(tree, fixFrom);
+
+    if (victim == currentNode) {
+        // Лист или один потомок: потомок (или пустота) занимает место узла
+        BNodeIndex child = nodes[currentNode].left != NO_NODE ? nodes[currentNode].left : nodes[currentNode].right;
+        replaceChild(tree, currentNode, child);
+    } else {
+        // Два потомка: ключ преемника переносится в узел, преемник (без левого потомка) вырезается
+        nodes[currentNode].key = std::move(nodes[victim].key);
+        replaceChild(tree, victim, nodes[victim].right);
     }
-    else if (currentNode->left != nullptr && currentNode->right == nullptr) {
-        if (currentNode->parent != nullptr) {
-            if (currentNode->parent->left == currentNode) {
-                currentNode->parent->left = currentNode->left;
-            } else {
-                currentNode->parent->right = currentNode->left;
-            }
-        } else {
-            tree->root = currentNode->left;
+    releaseNode(tree, victim);
+
+    if (tree->root == NO_NODE) {
+        // Последний узел удален: арена освобождается вместе со списком свободных слотов
+        clearTree(tree);
+        return;
+    }
+    if (fixFrom != NO_NODE) countNode(tree, fixFrom);
+    if (tree->balanced) rebalanceFrom(tree, fixFrom);
+    else for (BNodeIndex p = fixFrom; p != NO_NODE; p = nodes[p].parent) --nodes[p].size;
+}
+
+// Первый узел post-order поддерева: самый левый из самых глубоких
+template<typename Key>
+static BNodeIndex firstPostOrder(const BasicNode<Key>* nodes, BNodeIndex node) {
+    while (node != NO_NODE && (nodes[node].left != NO_NODE || nodes[node].right != NO_NODE)) {
+        node = nodes[node].left != NO_NODE ? nodes[node].left : nodes[node].right;
+    }
+    return node;
+}
+
+// Следующий узел post-order: правое поддерево родителя или сам родитель
+template<typename Key>
+static BNodeIndex nextPostOrder(const BasicNode<Key>* nodes, BNodeIndex node) {
+    BNodeIndex parent = nodes[node].parent;
+    if (parent != NO_NODE && nodes[parent].left == node && nodes[parent].right != NO_NODE) {
+        return firstPostOrder(nodes, nodes[parent].right);
+    }
+    return parent;
+}
+
+// Следующий узел pre-order: левый потомок, правый, или правый брат ближайшего предка
+template<typename Key>
+static BNodeIndex nextPreOrder(const BasicNode<Key>* nodes, BNodeIndex node) {
+    if (nodes[node].left != NO_NODE) return nodes[node].left;
+    if (nodes[node].right != NO_NODE) return nodes[node].right;
+    while (nodes[node].parent != NO_NODE) {
+        BNodeIndex parent = nodes[node].parent;
+        if (nodes[parent].left == node && nodes[parent].right != NO_NODE) return nodes[parent].right;
+        node = parent;
+    }
+    return NO_NODE;
+}
+
+template<typename Key, typename Compare>
+TreeTraversal<Key, Compare>::TreeTraversal(const BasicTree<Key, Compare>& tree, TreeOrder order)
+    : tree(tree), order(order) {
+    if (tree.root == NO_NODE) return;
+    switch (order) {
+        case TreeOrder::PRE: current = tree.root; break;
+        case TreeOrder::IN: current = findMinNode(tree, tree.root); break;
+        case TreeOrder::POST: current = firstPostOrder(tree.nodes.data(), tree.root); break;
+        case TreeOrder::BFS: queue.push_back(tree.root); break;
+    }
+}
+
+template<typename Key, typename Compare>
+const BasicNode<Key>* TreeTraversal<Key, Compare>::next() {
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    if (order == TreeOrder::BFS) {
+        if (queue.empty()) return nullptr;
+        BNodeIndex node = queue.front();
+        queue.pop_front();
+        if (nodes[node].left != NO_NODE) queue.push_back(nodes[node].left);
+        if (nodes[node].right != NO_NODE) queue.push_back(nodes[node].right);
+        return &nodes[node];
+    }
+    BNodeIndex node = current;
+    if (node == NO_NODE) return nullptr;
+    switch (order) {
+        case TreeOrder::PRE: current = nextPreOrder(nodes, node); break;
+        case TreeOrder::IN: current = findInOrderSuccessor(tree, node); break;
+        default: current = nextPostOrder(nodes, node); break;
+    }
+    return &nodes[node];
+}
+
+template<typename Key, typename Compare>
+void clearTree(BasicTree<Key, Compare>* tree) {
+    // Все узлы лежат в арене: она освобождается целиком
+    std::vector<BasicNode<Key>>().swap(tree->nodes);
+    tree->root = NO_NODE;
+    tree->freeList = NO_NODE;
+    tree->frozen = false;
+    tree->frozenKeys.clear();
+    tree->frozenKeys.shrink_to_fit();
+    for (std::size_t& count : tree->nodesByChildren) count = 0;
+}
+
+// Проверяет, что ключи образуют pre-order дерева поиска без повторов
+template<typename Key, typename Compare>
+static bool isSearchTreePreorder(const Key* keys, std::size_t count) {
+    using Tree = BasicTree<Key, Compare>;
+    std::vector<const Key*> stack;
+    const Key* lower = nullptr;
+    for (std::size_t i = 0; i < count; ++i) {
+        const Key& key = keys[i];
+        if (lower != nullptr && !Tree::less(*lower, key)) return false;
+        while (!stack.empty() && Tree::less(*stack.back(), key)) {
+            lower = stack.back();
+            stack.pop_back();
         }
-        currentNode->left->parent = currentNode->parent;
-        delete currentNode;
+        if (!stack.empty() && Tree::equal(*stack.back(), key)) return false;
+        stack.push_back(&key);
     }
-    else if (currentNode->left == nullptr && currentNode->right != nullptr) {
-        if (currentNode->parent != nullptr) {
-            if (currentNode->parent->left == currentNode) {
-                currentNode->parent->left = currentNode->right;
-            } else {
-                currentNode->parent->right = currentNode->right;
-            }
+    return true;
+}
+
+template<typename Key, typename Compare>
+void buildTreeFromPreorder(BasicTree<Key, Compare>* tree, const Key* keys, std::size_t count) {
+    using Tree = BasicTree<Key, Compare>;
+    clearTree(tree);
+    if (count == 0) return;
+    if (!isSearchTreePreorder<Key, Compare>(keys, count)) {
+        for (std::size_t i = 0; i < count; ++i) addNode(tree, keys[i]);
+        return;
+    }
+    if (count >= std::numeric_limits<BNodeIndex>::max()) {
+        throw std::runtime_error("Превышено количество узлов дерева");
+    }
+
+    // Ключ keys[i] - узел i + 1: арена заполняется подряд одним выделением
+    std::vector<BasicNode<Key>>& nodes = tree->nodes;
+    nodes.resize(count + 1);
+    nodes[0] = sentinelNode<Key>();
+    BNodeIndex last = static_cast<BNodeIndex>(count);
+    for (BNodeIndex i = 1; i <= last; ++i) nodes[i].key = keys[i - 1];
+    tree->root = 1;
+
+    // Стек - путь от корня к последнему узлу, у которого еще может появиться правый потомок
+    std::vector<BNodeIndex> stack;
+    stack.reserve(64);
+    stack.push_back(1);
+    for (BNodeIndex i = 2; i <= last; ++i) {
+        const Key& key = nodes[i].key;
+        if (Tree::less(key, nodes[stack.back()].key)) {
+            nodes[stack.back()].left = i;
+            nodes[i].parent = stack.back();
         } else {
-            tree->root = currentNode->right;
-        }
-        currentNode->right->parent = currentNode->parent;
-        delete currentNode;
-    }
-    else {
-        BNode* successor = findMinNode(currentNode->right);
-        currentNode->key = successor->key;
-        
-        if (successor->parent != nullptr) {
-            if (successor->parent->left == successor) {
-                successor->parent->left = successor->right;
-            } else {
-                successor->parent->right = successor->right;
+            BNodeIndex parent = NO_NODE;
+            while (!stack.empty() && Tree::less(nodes[stack.back()].key, key)) {
+                parent = stack.back();
+                stack.pop_back();
             }
+            nodes[parent].right = i;
+            nodes[i].parent = parent;
         }
-        
-        if (successor->right != nullptr) {
-            successor->right->parent = successor->parent;
-        }
-        delete successor;
+        stack.push_back(i);
     }
-}
-
-int countInnerNodes(BNode* currentNode) {
-    if (currentNode == nullptr || (currentNode->left == nullptr && currentNode->right == nullptr)) {return 0;}
-    return countInnerNodes(currentNode->left) + countInnerNodes(currentNode->right) + 1;
-}
 
-int countLeavesNodes(BNode* currentNode) {
-    if (currentNode == nullptr) {return 0;}
-    if (currentNode->left == nullptr && currentNode->right == nullptr) {return 1;}
-    return countLeavesNodes(currentNode->left) + countLeavesNodes(currentNode->right);
+    // Потомки лежат в арене после родителя: обратный проход считает размеры
+    // поддеревьев (и высоты для сбалансированного дерева) снизу вверх
+    for (BNodeIndex i = last; i >= 1; --i) {
+        updateNode(tree, i);
+        countNode(tree, i);
+    }
 }
 
 /**
  * Проверяет, является ли дерево полным (full tree).
- * 
+ *
  * Полное дерево (full binary tree) - это дерево, в котором каждый узел имеет
  * либо 0 потомков (является листом), либо ровно 2 потомков (является внутренним узлом).
- * 
+ *
  * Математическое свойство: в полном дереве количество внутренних узлов + 1 = количество листьев
- * 
+ *
  * Например:
  *       50          <- внутренний узел (2 потомка)
  *      /  \
  *    30    70       <- внутренние узлы (2 потомка каждый)
  *   /  \  /  \
  *  20 40 60 80     <- листовые узлы (0 потомков)
- * 
+ *
  * Внутренние узлы: 3 (50, 30, 70)
  * Листовые узлы: 4 (20, 40, 60, 80)
  * 3 + 1 = 4 -> TRUE (дерево полное)
  */
-bool isFullTree(const BTree& tree) {
-    return countInnerNodes(tree.root) + 1 == countLeavesNodes(tree.root);
+template<typename Key, typename Compare>
+bool isFullTree(const BasicTree<Key, Compare>& tree) {
+    // inner + 1 == leaves выполняется ровно тогда, когда нет узлов с одним потомком
+    return tree.nodesByChildren[1] == 0;
+}
+
+template<typename Key, typename Compare>
+std::size_t treeLeafCount(const BasicTree<Key, Compare>& tree) {
+    return tree.nodesByChildren[0];
+}
+
+template<typename Key, typename Compare>
+bool containsKey(const BasicTree<Key, Compare>& tree, const Key& key) {
+    using Tree = BasicTree<Key, Compare>;
+    if (tree.frozen) {
+        std::size_t k = frozenLowerBound(tree, key);
+        return k != 0 && Tree::equal(tree.frozenKeys[k], key);
+    }
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    BNodeIndex node = tree.root;
+    while (node != NO_NODE && !Tree::equal(nodes[node].key, key)) {
+        node = Tree::less(key, nodes[node].key) ? nodes[node].left : nodes[node].right;
+    }
+    return node != NO_NODE;
+}
+
+template<typename Key, typename Compare>
+void containsKeys(const BasicTree<Key, Compare>& tree, const std::vector<Key>& keys, std::vector<char>& found) {
+    using Tree = BasicTree<Key, Compare>;
+    found.assign(keys.size(), 0);
+    std::size_t n = treeSize(tree);
+    if (n == 0 || keys.empty()) return;
+
+    // Номера ключей по возрастанию ключа: ответы пишутся в исходном порядке
+    std::vector<std::size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::sort(order.begin(), order.end(),
+              [&](std::size_t a, std::size_t b) { return Tree::less(keys[a], keys[b]); });
+    // Спуск от корня стоит около log2(n) переходов: дальше идти по преемникам невыгодно
+    std::size_t budget = 1;
+    while ((std::size_t(1) << budget) < n) ++budget;
+
+    // Курсор - первый ключ дерева, не меньший текущего; после конца дерева
+    // (курсор 0) больших ключей тоже нет, поэтому новый спуск не нужен
+    bool positioned = false;
+    if (tree.frozen) {
+        std::size_t k = 0;
+        for (std::size_t i : order) {
+            const Key& key = keys[i];
+            for (std::size_t steps = 0; positioned && k != 0 && steps < budget &&
+                 Tree::less(tree.frozenKeys[k], key); ++steps) {
+                k = frozenSuccessor(tree, k);
+            }
+            if (!positioned || (k != 0 && Tree::less(tree.frozenKeys[k], key))) {
+                k = frozenLowerBound(tree, key);
+                positioned = true;
+            }
+            found[i] = k != 0 && Tree::equal(tree.frozenKeys[k], key);
+        }
+        return;
+    }
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    BNodeIndex node = NO_NODE;
+    for (std::size_t i : order) {
+        const Key& key = keys[i];
+        for (std::size_t steps = 0; positioned && node != NO_NODE && steps < budget &&
+             Tree::less(nodes[node].key, key); ++steps) {
+            node = findInOrderSuccessor(tree, node);
+        }
+        if (!positioned || (node != NO_NODE && Tree::less(nodes[node].key, key))) {
+            node = lowerBoundNode(tree, key);
+            positioned = true;
+        }
+        found[i] = node != NO_NODE && Tree::equal(nodes[node].key, key);
+    }
+}
+
+/*
+ * Замороженное дерево - неявное полное дерево поиска: узел k имеет потомков
+ * 2k и 2k + 1, родителя k / 2. Переходы in-order вычисляются по индексам.
+ */
+
+template<typename Key, typename Compare>
+static std::size_t frozenCount(const BasicTree<Key, Compare>& tree) {
+    return tree.frozenKeys.empty() ? 0 : tree.frozenKeys.size() - 1;
+}
+
+static std::size_t eytzingerFirst(std::size_t n) {
+    if (n == 0) return 0;
+    std::size_t k = 1;
+    while (2 * k <= n) k = 2 * k;
+    return k;
+}
+
+static std::size_t eytzingerNext(std::size_t n, std::size_t k) {
+    if (2 * k + 1 <= n) {
+        k = 2 * k + 1;
+        while (2 * k <= n) k = 2 * k;
+        return k;
+    }
+    // Поднимаемся, пока узел - правый потомок
+    while (k & 1) k >>= 1;
+    return k >> 1;
+}
+
+static std::size_t eytzingerPrev(std::size_t n, std::size_t k) {
+    if (2 * k <= n) {
+        k = 2 * k;
+        while (2 * k + 1 <= n) k = 2 * k + 1;
+        return k;
+    }
+    // Поднимаемся, пока узел - левый потомок
+    while (k != 0 && !(k & 1)) k >>= 1;
+    return k >> 1;
+}
+
+template<typename Key, typename Compare>
+std::size_t frozenFirst(const BasicTree<Key, Compare>& tree) {
+    return eytzingerFirst(frozenCount(tree));
+}
+
+template<typename Key, typename Compare>
+std::size_t frozenSuccessor(const BasicTree<Key, Compare>& tree, std::size_t k) {
+    return eytzingerNext(frozenCount(tree), k);
+}
+
+template<typename Key, typename Compare>
+std::size_t frozenPredecessor(const BasicTree<Key, Compare>& tree, std::size_t k) {
+    return eytzingerPrev(frozenCount(tree), k);
+}
+
+template<typename Key, typename Compare>
+std::size_t frozenLowerBound(const BasicTree<Key, Compare>& tree, const Key& key) {
+    const Key* keys = tree.frozenKeys.data();
+    std::size_t n = frozenCount(tree);
+    std::size_t k = 1;
+    while (k <= n) {
+#if defined(__GNUC__)
+        // Через 4 уровня потомки k лежат подряд с индекса 16k: одна-две строки кэша
+        __builtin_prefetch(keys + 16 * k);
+#endif
+        k = 2 * k + BasicTree<Key, Compare>::less(keys[k], key);
+    }
+    // Отменяем последние повороты направо: остается узел, где спуск ушел налево
+#if defined(__GNUC__)
+    k >>= __builtin_ffsll(static_cast<long long>(~k));
+#else
+    while (k & 1) k >>= 1;
+    k >>= 1;
+#endif
+    return k;
+}
+
+template<typename Key, typename Compare>
+void freezeTree(BasicTree<Key, Compare>* tree) {
+    if (tree->frozen) return;
+    // Ключи по возрастанию (обход in-order)
+    std::vector<Key> sorted;
+    sorted.reserve(treeSize(*tree));
+    TreeTraversal walk(*tree, TreeOrder::IN);
+    while (const BasicNode<Key>* node = walk.next()) sorted.push_back(node->key);
+
+    // Узлы остаются: форма дерева нужна обходам, TCHECK и размораживанию
+    std::size_t n = sorted.size();
+    std::vector<Key> keys(n + 1);
+    std::size_t i = 0;
+    for (std::size_t k = eytzingerFirst(n); k != 0; k = eytzingerNext(n, k)) {
+        keys[k] = std::move(sorted[i++]);
+    }
+    tree->frozenKeys.swap(keys);
+    tree->frozen = true;
+}
+
+template<typename Key, typename Compare>
+void thawTree(BasicTree<Key, Compare>* tree) {
+    if (!tree->frozen) return;
+    // Узлы не менялись, пока дерево было заморожено: достаточно убрать массив
+    tree->frozen = false;
+    tree->frozenKeys.clear();
+    tree->frozenKeys.shrink_to_fit();
+}
+
+// Размер поддерева узла k неявного полного дерева из n узлов: сумма по уровням
+static std::size_t eytzingerSubtreeSize(std::size_t n, std::size_t k) {
+    std::size_t total = 0;
+    for (std::size_t lo = k, hi = k; lo <= n; lo = 2 * lo, hi = 2 * hi + 1) {
+        total += std::min(hi, n) - lo + 1;
+    }
+    return total;
+}
+
+template<typename Key, typename Compare>
+std::size_t treeSize(const BasicTree<Key, Compare>& tree) {
+    return tree.root == NO_NODE ? 0 : nodeSize(tree, tree.root);
 }
 
-int tGet(BTree* tree, int key) {
-    if (tree == nullptr || tree->root == nullptr) {
-        throw std::runtime_error("Ключ не найден"); 
+// Количество ключей, меньших key (или не больших key при inclusive)
+template<typename Key, typename Compare>
+static std::size_t countBelow(const BasicTree<Key, Compare>& tree, const Key& key, bool inclusive) {
+    using Tree = BasicTree<Key, Compare>;
+    auto below = [&](const Key& nodeKey) {
+        return inclusive ? !Tree::less(key, nodeKey) : Tree::less(nodeKey, key);
+    };
+    std::size_t rank = 0;
+    if (tree.frozen) {
+        std::size_t n = frozenCount(tree);
+        std::size_t k = 1;
+        while (k <= n) {
+            if (below(tree.frozenKeys[k])) {
+                rank += eytzingerSubtreeSize(n, 2 * k) + 1;
+                k = 2 * k + 1;
+            } else {
+                k = 2 * k;
+            }
+        }
+        return rank;
+    }
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    BNodeIndex node = tree.root;
+    while (node != NO_NODE) {
+        if (below(nodes[node].key)) {
+            rank += nodeSize(tree, nodes[node].left) + 1;
+            node = nodes[node].right;
+        } else {
+            node = nodes[node].left;
+        }
+    }
+    return rank;
+}
+
+template<typename Key, typename Compare>
+std::size_t rankKey(const BasicTree<Key, Compare>& tree, const Key& key) {
+    return countBelow(tree, key, false);
+}
+
+template<typename Key, typename Compare>
+std::size_t countRange(const BasicTree<Key, Compare>& tree, const Key& lo, const Key& hi) {
+    if (BasicTree<Key, Compare>::less(hi, lo)) return 0;
+    return countBelow(tree, hi, true) - countBelow(tree, lo, false);
+}
+
+template<typename Key, typename Compare>
+const Key& selectKey(const BasicTree<Key, Compare>& tree, std::size_t k) {
+    if (k >= treeSize(tree)) throw std::runtime_error("Индекс вне диапазона");
+    if (tree.frozen) {
+        std::size_t n = frozenCount(tree);
+        std::size_t node = 1;
+        while (true) {
+            std::size_t leftSize = eytzingerSubtreeSize(n, 2 * node);
+            if (k == leftSize) return tree.frozenKeys[node];
+            if (k < leftSize) {
+                node = 2 * node;
+            } else {
+                k -= leftSize + 1;
+                node = 2 * node + 1;
+            }
+        }
+    }
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    BNodeIndex node = tree.root;
+    while (true) {
+        std::size_t leftSize = nodeSize(tree, nodes[node].left);
+        if (k == leftSize) return nodes[node].key;
+        if (k < leftSize) {
+            node = nodes[node].left;
+        } else {
+            k -= leftSize + 1;
+            node = nodes[node].right;
+        }
+    }
+}
+
+template<typename Key, typename Compare>
+BNodeIndex lowerBoundNode(const BasicTree<Key, Compare>& tree, const Key& key) {
+    const BasicNode<Key>* nodes = tree.nodes.data();
+    BNodeIndex best = NO_NODE;
+    BNodeIndex node = tree.root;
+    while (node != NO_NODE) {
+        if (BasicTree<Key, Compare>::less(nodes[node].key, key)) {
+            node = nodes[node].right;
+        } else {
+            best = node;
+            node = nodes[node].left;
+        }
+    }
+    return best;
+}
+
+template<typename Key, typename Compare>
+Key tGet(BasicTree<Key, Compare>* tree, const Key& key) {
+    if (tree == nullptr || tree->root == NO_NODE) {
+        throw std::runtime_error("Ключ не найден");
+    }
+    return tree->nodes[findNode(*tree, key)].key;
+}
+
+// Чтение и запись ключа в текстовой и бинарной форме (по типу ключа)
+static void readTextKey(TextReader& in, int& key) { key = in.nextNumber<int>(); }
+static void readTextKey(TextReader& in, std::int64_t& key) { key = in.nextNumber<std::int64_t>(); }
+static void readTextKey(TextReader& in, std::string& key) {
+    std::string_view token = in.next();
+    if (token.empty()) throw std::runtime_error("Malformed text record");
+    key.assign(token.data(), token.size());
+}
+
+static void appendBinaryKey(std::string& out, int key) { appendI32(out, key); }
+static void appendBinaryKey(std::string& out, std::int64_t key) { appendI64(out, key); }
+static void appendBinaryKey(std::string& out, const std::string& key) { appendString(out, key); }
+
+static void readBinaryKey(BinaryReader& in, int& key) { key = in.readI32(); }
+static void readBinaryKey(BinaryReader& in, std::int64_t& key) { key = in.readI64(); }
+static void readBinaryKey(BinaryReader& in, std::string& key) { key = in.readString(); }
+
+// Необязательное слово типа ключей после имени: I64 или STR (нет слова - int32)
+static TreeKeyType readKeyTypeTag(TextReader& in) {
+    TextReader probe = in;
+    std::string_view word = probe.next();
+    if (word == TreeKeyTraits<std::int64_t>::tag) { in = probe; return TreeKeyType::INT64; }
+    if (word == TreeKeyTraits<std::string>::tag) { in = probe; return TreeKeyType::STRING; }
+    return TreeKeyType::INT32;
+}
+
+TreeKeyType textTreeKeyType(std::string_view record) {
+    TextReader in(record);
+    in.next(); // T
+    in.next(); // name
+    return readKeyTypeTag(in);
+}
+
+TreeKeyType binaryTreeKeyType(const char* data, std::size_t size) {
+    BinaryReader in(data, size);
+    std::uint64_t count = in.readU64();
+    return static_cast<TreeKeyType>((count & BTREE_KEY_TYPE_MASK) >> BTREE_KEY_TYPE_SHIFT);
+}
+
+Structure* createTree(TreeKeyType type) {
+    switch (type) {
+        case TreeKeyType::INT64: return new BTree64();
+        case TreeKeyType::STRING: return new StringBTree();
+        default: return new BTree();
     }
-    return (findNode(*tree, key))->key;
 }
 
 /**
  * Сериализация бинарного дерева в строку.
- * 
+ *
  * Формат: "T name count key1 key2 ... keyN"
  * где ключи идут в порядке предпорядкового обхода (pre-order):
  *  1. Посещаем корень
  *  2. Рекурсивно обходим левое поддерево
  *  3. Рекурсивно обходим правое поддерево
- * 
+ *
  * Пример: для дерева
  *       50
  *      /  \
@@ -208,63 +818,114 @@ int tGet(BTree* tree, int key) {
  *   20 40 60 80
  * Pre-order: 50, 30, 20, 40, 70, 60, 80
  */
-std::string BTree::serialize() const {
-    // Первый проход: считаем количество узлов
-    int count = 0;
-    std::ostringstream oss;
-    std::function<void(BNode*)> pre = [&](BNode* node) {
-        if (!node) return;
-        ++count;
-        pre(node->left);
-        pre(node->right);
-    };
-    pre(root);
-
-    // Второй проход: выводим значения узлов в порядке pre-order
-    std::function<void(BNode*)> preOut = [&](BNode* node) {
-        if (!node) return;
-        oss << node->key << " ";
-        preOut(node->left);
-        preOut(node->right);
-    };
-    // Build full line: T <name> <count> <vals...>
-    std::ostringstream line;
-    line << "T " << name << " " << count;
-    preOut(root);
-    std::string values = oss.str();
-    if (!values.empty()) {
-        // preOut wrote to oss incorrectly earlier; use a fresh traversal
-        oss.str(""); oss.clear();
-        preOut(root);
-        values = oss.str();
-        // trim trailing space
-        if (!values.empty() && values.back() == ' ') values.pop_back();
-        line << " " << values;
-    }
-    return line.str();
-}
-
-void BTree::deserialize(const std::string& data) {
-    // data expected like: T <name> <count> <vals...>
-    std::istringstream iss(data);
-    std::string type;
-    iss >> type; // T
-    iss >> name;
-    int count = 0;
-    iss >> count;
-    // очистка существующего дерева
-    std::function<void(BNode*)> del = [&](BNode* node) {
-        if (!node) return;
-        del(node->left);
-        del(node->right);
-        delete node;
-    };
-    del(root);
-    root = nullptr;
+template<typename Key, typename Compare>
+void BasicTree<Key, Compare>::serializeTo(Writer& out) const {
+    out.write("T ");
+    out.write(name);
+    out.put(' ');
+    if (TreeKeyTraits<Key>::type != TreeKeyType::INT32) {
+        out.write(TreeKeyTraits<Key>::tag);
+        out.put(' ');
+    }
+    if (balanced) out.write("AVL ");
+    if (frozen) out.write("FROZEN ");
 
-    for (int i = 0; i < count; ++i) {
-        int key;
-        iss >> key;
-        addNode(const_cast<BTree*>(this), key);
+    // Количество известно из размера корня: ключи выводятся одним проходом pre-order
+    out.writeNumber(static_cast<std::uint64_t>(treeSize(*this)));
+    TreeTraversal walk(*this, TreeOrder::PRE);
+    while (const Node* node = walk.next()) {
+        out.put(' ');
+        writeTreeKey(out, node->key);
     }
-}
\ No newline at end of file
+}
+
+template<typename Key, typename Compare>
+void BasicTree<Key, Compare>::deserializeFrom(std::string_view data) {
+    // data expected like: T <name> [I64|STR] [AVL] [FROZEN] <count> <vals...>
+    TextReader in(data);
+    in.next(); // T
+    name = std::string(in.next());
+    if (readKeyTypeTag(in) != TreeKeyTraits<Key>::type) throw std::runtime_error("Tree key type mismatch");
+    TextReader probe = in;
+    balanced = probe.next() == "AVL";
+    if (balanced) in = probe;
+    probe = in;
+    bool frozenRecord = probe.next() == "FROZEN";
+    if (frozenRecord) in = probe;
+    std::uint64_t count = in.nextNumber<std::uint64_t>();
+    std::vector<Key> keys;
+    keys.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(count, data.size() / 2 + 1)));
+    for (std::uint64_t i = 0; i < count; ++i) {
+        keys.emplace_back();
+        readTextKey(in, keys.back());
+    }
+    buildTreeFromPreorder(this, keys.data(), keys.size());
+    if (frozenRecord) freezeTree(this);
+}
+
+template<typename Key, typename Compare>
+void BasicTree<Key, Compare>::serializeBinary(std::string& out) const {
+    std::uint64_t flags = (balanced ? BTREE_FLAG_AVL : 0) | (frozen ? BTREE_FLAG_FROZEN : 0) |
+                          (static_cast<std::uint64_t>(TreeKeyTraits<Key>::type) << BTREE_KEY_TYPE_SHIFT);
+    std::size_t count = treeSize(*this);
+    appendU64(out, count | flags);
+    if constexpr (std::is_arithmetic_v<Key>) out.reserve(out.size() + count * sizeof(Key));
+    TreeTraversal walk(*this, TreeOrder::PRE);
+    while (const Node* node = walk.next()) appendBinaryKey(out, node->key);
+}
+
+template<typename Key, typename Compare>
+void BasicTree<Key, Compare>::deserializeBinary(const char* data, std::size_t size) {
+    BinaryReader in(data, size);
+    std::uint64_t count = in.readU64();
+    balanced = (count & BTREE_FLAG_AVL) != 0;
+    bool frozenRecord = (count & BTREE_FLAG_FROZEN) != 0;
+    if (static_cast<TreeKeyType>((count & BTREE_KEY_TYPE_MASK) >> BTREE_KEY_TYPE_SHIFT) != TreeKeyTraits<Key>::type) {
+        throw std::runtime_error("Tree key type mismatch");
+    }
+    count &= BTREE_COUNT_MASK;
+    // Любой ключ занимает не меньше 4 байт (int32 или длина строки)
+    if (count > size / sizeof(std::int32_t)) throw std::runtime_error("Truncated binary snapshot");
+    std::vector<Key> keys(static_cast<std::size_t>(count));
+    for (Key& key : keys) readBinaryKey(in, key);
+    // Ключи идут в порядке pre-order: форма дерева восстанавливается за один проход
+    buildTreeFromPreorder(this, keys.data(), keys.size());
+    if (frozenRecord) freezeTree(this);
+}
+
+// Явные инстанцирования для поддерживаемых типов ключей
+#define INSTANTIATE_TREE(KEY) \
+    template struct BasicTree<KEY>; \
+    template struct TreeTraversal<KEY, std::less<KEY>>; \
+    template void clearTree(BasicTree<KEY>*); \
+    template BNodeIndex findPlaceNode(const BasicTree<KEY>&, BNodeIndex, const KEY&); \
+    template void addNode(BasicTree<KEY>*, const KEY&); \
+    template void buildTreeFromPreorder(BasicTree<KEY>*, const KEY*, std::size_t); \
+    template BNodeIndex allocateNode(BasicTree<KEY>*, const KEY&); \
+    template void releaseNode(BasicTree<KEY>*, BNodeIndex); \
+    template BNodeIndex findNode(const BasicTree<KEY>&, const KEY&); \
+    template BNodeIndex findMinNode(const BasicTree<KEY>&, BNodeIndex); \
+    template BNodeIndex findMaxNode(const BasicTree<KEY>&, BNodeIndex); \
+    template BNodeIndex findInOrderPredecessor(const BasicTree<KEY>&, BNodeIndex); \
+    template BNodeIndex findInOrderSuccessor(const BasicTree<KEY>&, BNodeIndex); \
+    template void deleteNode(BasicTree<KEY>*, const KEY&); \
+    template bool isFullTree(const BasicTree<KEY>&); \
+    template std::size_t treeLeafCount(const BasicTree<KEY>&); \
+    template bool containsKey(const BasicTree<KEY>&, const KEY&); \
+    template void containsKeys(const BasicTree<KEY>&, const std::vector<KEY>&, std::vector<char>&); \
+    template void freezeTree(BasicTree<KEY>*); \
+    template void thawTree(BasicTree<KEY>*); \
+    template std::size_t frozenLowerBound(const BasicTree<KEY>&, const KEY&); \
+    template std::size_t frozenSuccessor(const BasicTree<KEY>&, std::size_t); \
+    template std::size_t frozenPredecessor(const BasicTree<KEY>&, std::size_t); \
+    template std::size_t frozenFirst(const BasicTree<KEY>&); \
+    template std::size_t treeSize(const BasicTree<KEY>&); \
+    template std::size_t rankKey(const BasicTree<KEY>&, const KEY&); \
+    template const KEY& selectKey(const BasicTree<KEY>&, std::size_t); \
+    template std::size_t countRange(const BasicTree<KEY>&, const KEY&, const KEY&); \
+    template BNodeIndex lowerBoundNode(const BasicTree<KEY>&, const KEY&); \
+    template KEY tGet(BasicTree<KEY>*, const KEY&);
+
+INSTANTIATE_TREE(int)
+INSTANTIATE_TREE(std::int64_t)
+INSTANTIATE_TREE(std::string)
@@ -3,24 +3,88 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
 
 #include "Structure.h"
 
+/**
+ * @brief Индекс узла в арене дерева (BasicTree::nodes).
+ *
+ * Узлы ссылаются друг на друга 32-битными индексами вместо указателей:
+ * узел занимает 24 байта вместо 40 (и без заголовка блока new), а соседние
+ * по арене узлы попадают в одни строки кэша.
+ */
+using BNodeIndex = std::uint32_t;
+
+/** @brief Отсутствие узла (аналог nullptr); слот 0 арены - заглушка с нулевыми высотой и размером */
+constexpr BNodeIndex NO_NODE = 0;
+
+/**
+ * @brief Тип ключей дерева; записывается в сохраненную форму.
+ *
+ * Текстовая запись помечает тип словом после имени ("I64", "STR"; у INT32
+ * слова нет, поэтому записи прежнего формата читаются как INT32), бинарная -
+ * битами BTREE_KEY_TYPE_MASK в старшем байте счетчика.
+ */
+enum class TreeKeyType { INT32 = 0, INT64 = 1, STRING = 2 };
+
+/**
+ * @brief Свойства типа ключа, известные при компиляции.
+ *
+ * Определены для int, std::int64_t и std::string - типов, для которых
+ * инстанцируется BasicTree: type - код типа, tag - слово в текстовой записи.
+ */
+template<typename Key>
+struct TreeKeyTraits;
+
+template<>
+struct TreeKeyTraits<int> {
+    static constexpr TreeKeyType type = TreeKeyType::INT32;
+    static constexpr const char* tag = "";
+};
+
+template<>
+struct TreeKeyTraits<std::int64_t> {
+    static constexpr TreeKeyType type = TreeKeyType::INT64;
+    static constexpr const char* tag = "I64";
+};
+
+template<>
+struct TreeKeyTraits<std::string> {
+    static constexpr TreeKeyType type = TreeKeyType::STRING;
+    static constexpr const char* tag = "STR";
+};
+
+/** @brief Дописывает ключ дерева в текстовую запись или вывод команды */
+inline void writeTreeKey(Writer& out, int key) { out.writeNumber(key); }
+inline void writeTreeKey(Writer& out, std::int64_t key) { out.writeNumber(key); }
+inline void writeTreeKey(Writer& out, const std::string& key) { out.write(key); }
+
 /**
  * @brief Узел бинарного дерева поиска.
  *
- * Хранит целочисленный ключ и указатели на левого, правого потомков и родителя.
- */
-struct BNode {
-    /** @brief Целочисленный ключ, хранящийся в узле */
-    int key = -1;
-    /** @brief Указатель на левого потомка (nullptr если отсутствует) */
-    BNode* left = nullptr;
-    /** @brief Указатель на правого потомка (nullptr если отсутствует) */
-    BNode* right = nullptr;
-    /** @brief Указатель на родительский узел (nullptr для корня) */
-    BNode* parent = nullptr;
+ * Хранит ключ, индексы левого, правого потомков и родителя в арене дерева
+ * и размер своего поддерева (для порядковых запросов TRANK/TSELECT).
+ */
+template<typename Key>
+struct BasicNode {
+    /** @brief Ключ, хранящийся в узле */
+    Key key{};
+    /** @brief Левый потомок (NO_NODE если отсутствует; у свободного слота - следующий свободный) */
+    BNodeIndex left = NO_NODE;
+    /** @brief Правый потомок (NO_NODE если отсутствует) */
+    BNodeIndex right = NO_NODE;
+    /** @brief Родительский узел (NO_NODE для корня) */
+    BNodeIndex parent = NO_NODE;
+    /** @brief Высота поддерева (поддерживается только в сбалансированном режиме) */
+    int height = 1;
+    /** @brief Количество узлов в поддереве, включая сам узел */
+    std::uint32_t size = 1;
 };
 
 /**
@@ -29,61 +93,212 @@ struct BNode {
  * Бинарное дерево, в котором все внутренние узлы имеют ровно двух потомков
  * (или это полное дерево по определению задания). Поддерживает операции поиска,
  * вставки, удаления, и различные варианты обхода (pre-order, in-order, post-order, BFS).
+ *
+ * Сбалансированный режим (AVL, "TCREATE name AVL"): после вставки и удаления
+ * дерево перестраивается поворотами, поэтому высота остается O(log n) при любом
+ * порядке ключей (в обычном режиме возрастающие ключи вырождают дерево в список).
+ * Режим записывается в сериализованную форму.
+ *
+ * Замороженное дерево ("TFREEZE name"): рядом с узлами хранится массив ключей
+ * в порядке Эйтцингера (BFS полного дерева поиска, см. BasicTree::frozenKeys).
+ * Поиск идет по массиву без указателей, обходы и TCHECK - по неизменным узлам;
+ * первая мутация размораживает дерево, отбрасывая массив.
+ *
+ * Узлы хранятся в арене BasicTree::nodes (один непрерывный массив на дерево):
+ * удаленные слоты собираются в список свободных и переиспользуются вставками,
+ * а очистка дерева - одно освобождение памяти вместо обхода всех узлов.
+ *
+ * Тип ключа и сравнение - параметры шаблона: сравнение подставляется
+ * при компиляции. Шаблон инстанцирован (в FullBinaryTree.cpp) для int
+ * (BTree, "TCREATE name"), std::int64_t (BTree64, "TCREATE name I64")
+ * и std::string (StringBTree, "TCREATE name STR").
  */
-struct BTree : public Structure {
-    /** @brief Указатель на корень дерева (nullptr если дерево пусто) */
-    BNode* root = nullptr;
+template<typename Key, typename Compare = std::less<Key>>
+struct BasicTree;
+
+/**
+ * @brief Удаляет все узлы дерева: арена освобождается целиком.
+ * @param tree Указатель на дерево
+ */
+template<typename Key, typename Compare>
+void clearTree(BasicTree<Key, Compare>* tree);
+
+template<typename Key, typename Compare>
+struct BasicTree : public Structure {
+    using KeyType = Key;
+    using Node = BasicNode<Key>;
+
+    /** @brief Порядок ключей дерева */
+    static bool less(const Key& a, const Key& b) { return Compare()(a, b); }
+    /** @brief Равенство ключей в смысле Compare */
+    static bool equal(const Key& a, const Key& b) { return !less(a, b) && !less(b, a); }
+
+    /** @brief Корень дерева (NO_NODE если дерево пусто) */
+    BNodeIndex root = NO_NODE;
+    /**
+     * @brief Арена узлов: узел с индексом i - nodes[i].
+     *
+     * nodes[0] - заглушка для NO_NODE (пустая арена, пока в дереве нет узлов).
+     * Индексы узлов не меняются при росте арены, но указатели и ссылки на
+     * элементы nodes действительны только до следующего allocateNode().
+     */
+    std::vector<Node> nodes;
+    /** @brief Начало списка свободных слотов арены (связаны через BasicNode::left) */
+    BNodeIndex freeList = NO_NODE;
+    /** @brief Сбалансированный режим (AVL), задается при создании */
+    bool balanced = false;
+    /** @brief Дерево заморожено: поиск идет по frozenKeys, узлы не меняются */
+    bool frozen = false;
+    /**
+     * @brief Ключи замороженного дерева в порядке Эйтцингера, с единицы.
+     *
+     * frozenKeys[0] не используется; потомки frozenKeys[k] - frozenKeys[2k]
+     * и frozenKeys[2k + 1], обход in-order дает ключи по возрастанию.
+     */
+    std::vector<Key> frozenKeys;
+    /**
+     * @brief Количество узлов с 0, 1 и 2 потомками.
+     *
+     * Поддерживается в addNode()/deleteNode() и при загрузке, поэтому TCHECK
+     * и количество листьев - чтение счетчиков за O(1).
+     */
+    std::size_t nodesByChildren[3] = {0, 0, 0};
     
-    BTree() = default;
-    ~BTree() override {
-        std::function<void(BNode*)> deleteTree = [&](BNode* node) {
-            if (!node) return;
-            deleteTree(node->left);
-            deleteTree(node->right);
-            delete node;
-        };
-        deleteTree(root);
-        root = nullptr;
-    }
+    BasicTree() = default;
+    ~BasicTree() override { clearTree(this); }
     
     /**
-     * @brief Сериализует дерево в формат: "T name count val1 val2 ..."
+     * @brief Сериализует дерево в формат: "T name [I64|STR] [AVL] [FROZEN] count val1 val2 ..."
      * 
      * Формат: предпорядковый обход дерева (pre-order: корень, левое поддерево, правое поддерево).
-     * @return Строка с сохраненным состоянием дерева
+     * Тип ключей (кроме int32) указывается словом после имени. Слово AVL
+     * присутствует только у сбалансированного дерева. Замороженное
+     * дерево помечается словом FROZEN; массив frozenKeys при загрузке строится заново.
+     * @param out Буфер записи, в который дописывается строка
      */
-    std::string serialize() const override;
+    void serializeTo(Writer& out) const override;
     
     /**
-     * @brief Десериализует дерево из строки формата "T name count val1 val2 ..."
+     * @brief Десериализует дерево из строки формата "T name [I64|STR] [AVL] [FROZEN] count val1 val2 ..."
      * 
-     * Восстанавливает дерево путем вставки значений в порядке их появления.
+     * Восстанавливает форму дерева по pre-order за O(n) (см. buildTreeFromPreorder()).
      * @param data Строка с сохраненными данными дерева
+     * @throw std::runtime_error если тип ключей записи не совпадает с Key
      */
-    void deserialize(const std::string& data) override;
+    void deserializeFrom(std::string_view data) override;
+
+    /**
+     * @brief Записывает дерево в бинарной форме: uint64 (count, флаги режима и тип ключей), затем ключи в порядке pre-order
+     *
+     * Ключи int32 и int64 записываются как есть, строки - длиной и байтами.
+     * @param out Буфер для дописывания данных
+     */
+    void serializeBinary(std::string& out) const override;
+
+    /**
+     * @brief Восстанавливает дерево из бинарной формы
+     * @param data Начало полезной нагрузки
+     * @param size Длина полезной нагрузки в байтах
+     * @throw std::runtime_error если тип ключей записи не совпадает с Key
+     */
+    void deserializeBinary(const char* data, std::size_t size) override;
 };
 
+/** @brief Дерево целочисленных ключей int32 (тип по умолчанию) */
+using BTree = BasicTree<int>;
+/** @brief Дерево 64-битных ключей */
+using BTree64 = BasicTree<std::int64_t>;
+/** @brief Дерево строковых ключей */
+using StringBTree = BasicTree<std::string>;
+/** @brief Узел дерева BTree */
+using BNode = BasicNode<int>;
+
+/**
+ * @brief Тип ключей дерева по текстовой записи "T name [I64|STR] ..."
+ * @param record Строка записи
+ */
+TreeKeyType textTreeKeyType(std::string_view record);
+
+/**
+ * @brief Тип ключей дерева по бинарной полезной нагрузке (флаги счетчика)
+ * @param data Начало полезной нагрузки
+ * @param size Длина полезной нагрузки в байтах
+ */
+TreeKeyType binaryTreeKeyType(const char* data, std::size_t size);
+
+/**
+ * @brief Создает пустое дерево с ключами заданного типа.
+ * @param type Тип ключей
+ * @return BTree, BTree64 или StringBTree (выделено в heap)
+ */
+Structure* createTree(TreeKeyType type);
+
 /**
  * @brief Находит позицию для вставки нового узла с заданным ключом.
  * 
- * Рекурсивно спускается по дереву в соответствии с правилами BST,
+ * Спускается по дереву (итеративно) в соответствии с правилами BST,
  * возвращая узел, где должен быть вставлен новый элемент.
  * 
- * @param currentNode Текущий узел при поиске
+ * @param tree Ссылка на дерево
+ * @param currentNode Узел, с которого начинается спуск
  * @param key Ключ для вставки
- * @return Указатель на узел, под которым должен быть вставлен новый узел
+ * @return Узел, под которым должен быть вставлен новый узел (или узел с ключом key)
  */
-BNode* findPlaceNode(BNode* currentNode, int key);
+template<typename Key, typename Compare>
+BNodeIndex findPlaceNode(const BasicTree<Key, Compare>& tree, BNodeIndex currentNode, const Key& key);
 
 /**
  * @brief Добавляет новый узел с заданным ключом в дерево.
  * 
- * Вставляет узел в соответствии с правилами бинарного дерева поиска.
+ * Вставляет узел в соответствии с правилами бинарного дерева поиска;
+ * в сбалансированном режиме затем восстанавливает баланс AVL.
  * 
  * @param tree Указатель на дерево
  * @param key Ключ для вставки
  */
-void addNode(BTree* tree, int key);
+template<typename Key, typename Compare>
+void addNode(BasicTree<Key, Compare>* tree, const Key& key);
+
+/**
+ * @brief Восстанавливает дерево по ключам в порядке pre-order за O(n).
+ *
+ * Pre-order дерева поиска однозначно задает его форму: очередной ключ - левый
+ * потомок вершины стека, если он меньше ее, иначе правый потомок последнего
+ * снятого со стека узла с меньшим ключом. Каждый узел попадает в стек и
+ * снимается с него один раз, поэтому построение линейно и для вырожденных
+ * деревьев (в отличие от count вызовов addNode()). Узлы занимают арену подряд
+ * в порядке pre-order, без свободных слотов; ссылки на родителей выставляются.
+ *
+ * Если последовательность не является pre-order дерева поиска (например,
+ * файл правили вручную), дерево строится вставкой ключей по одному.
+ * Размеры поддеревьев (и высоты для сбалансированного дерева) пересчитываются
+ * тем же проходом.
+ *
+ * @param tree Указатель на дерево (прежнее содержимое удаляется)
+ * @param keys Ключи в порядке pre-order
+ * @param count Количество ключей
+ * @throw std::runtime_error если ключи повторяются
+ */
+template<typename Key, typename Compare>
+void buildTreeFromPreorder(BasicTree<Key, Compare>* tree, const Key* keys, std::size_t count);
+
+/**
+ * @brief Выделяет узел в арене дерева: свободный слот или новый в конце арены.
+ * @param tree Указатель на дерево
+ * @param key Ключ нового узла
+ * @return Индекс узла без потомков и родителя
+ * @throw std::runtime_error если индексы арены исчерпаны
+ */
+template<typename Key, typename Compare>
+BNodeIndex allocateNode(BasicTree<Key, Compare>* tree, const Key& key);
+
+/**
+ * @brief Возвращает слот узла, исключенного из дерева, в список свободных.
+ * @param tree Указатель на дерево
+ * @param node Узел, уже отсоединенный от дерева
+ */
+template<typename Key, typename Compare>
+void releaseNode(BasicTree<Key, Compare>* tree, BNodeIndex node);
 
 /**
  * @brief Находит узел с заданным ключом в дереве.
@@ -92,50 +307,91 @@ void addNode(BTree* tree, int key);
  * 
  * @param tree Ссылка на дерево
  * @param key Ключ для поиска
- * @return Указатель на найденный узел
+ * @return Индекс найденного узла
  * @throw std::runtime_error если узел не найден
  */
-BNode* findNode(const BTree& tree, int key);
+template<typename Key, typename Compare>
+BNodeIndex findNode(const BasicTree<Key, Compare>& tree, const Key& key);
 
 /**
  * @brief Находит узел с минимальным ключом в поддереве.
  * 
- * Рекурсивно спускается в левое поддерево для нахождения минимального элемента.
+ * Спускается (итеративно) в левое поддерево для нахождения минимального элемента.
  * 
+ * @param tree Ссылка на дерево
  * @param currentNode Корень поддерева
- * @return Указатель на узел с минимальным ключом
+ * @return Узел с минимальным ключом
  */
-BNode* findMinNode(BNode* currentNode);
+template<typename Key, typename Compare>
+BNodeIndex findMinNode(const BasicTree<Key, Compare>& tree, BNodeIndex currentNode);
 
 /**
  * @brief Находит узел с максимальным ключом в поддереве.
  * 
- * Рекурсивно спускается в правое поддерево для нахождения максимального элемента.
+ * Спускается (итеративно) в правое поддерево для нахождения максимального элемента.
  * 
+ * @param tree Ссылка на дерево
  * @param currentNode Корень поддерева
- * @return Указатель на узел с максимальным ключом
+ * @return Узел с максимальным ключом
  */
-BNode* findMaxNode(BNode* currentNode);
+template<typename Key, typename Compare>
+BNodeIndex findMaxNode(const BasicTree<Key, Compare>& tree, BNodeIndex currentNode);
 
 /**
  * @brief Находит ближайшего предшественника узла в порядке in-order.
  * 
  * Предшественник - это узел с наибольшим ключом, который меньше ключа текущего узла.
  * 
- * @param node Указатель на узел
- * @return Указатель на предшественника или nullptr если его нет
+ * @param tree Ссылка на дерево
+ * @param node Узел
+ * @return Предшественник или NO_NODE если его нет
  */
-BNode* findInOrderPredecessor(BNode* node);
+template<typename Key, typename Compare>
+BNodeIndex findInOrderPredecessor(const BasicTree<Key, Compare>& tree, BNodeIndex node);
 
 /**
  * @brief Находит ближайшего преемника узла в порядке in-order.
  * 
  * Преемник - это узел с наименьшим ключом, который больше ключа текущего узла.
  * 
- * @param node Указатель на узел
- * @return Указатель на преемника или nullptr если его нет
+ * @param tree Ссылка на дерево
+ * @param node Узел
+ * @return Преемник или NO_NODE если его нет
+ */
+template<typename Key, typename Compare>
+BNodeIndex findInOrderSuccessor(const BasicTree<Key, Compare>& tree, BNodeIndex node);
+
+/** @brief Порядок обхода дерева (режимы TGET PRE/IN/POST/BFS) */
+enum class TreeOrder { PRE, IN, POST, BFS };
+
+/**
+ * @brief Итеративный обход дерева без рекурсии и std::function.
+ *
+ * PRE, IN и POST переходят к следующему узлу по ссылкам на родителей
+ * и не используют дополнительной памяти, поэтому глубина дерева (у вырожденного
+ * дерева она равна числу узлов) не ограничена стеком. BFS хранит очередь
+ * текущего уровня.
+ *
+ * Пример (параметры шаблона выводятся из дерева):
+ *   TreeTraversal walk(tree, TreeOrder::IN);
+ *   while (const auto* node = walk.next()) { ... }
+ *
+ * Дерево не должно меняться во время обхода: выданный указатель ссылается
+ * в арену и перестает быть действительным после вставки.
  */
-BNode* findInOrderSuccessor(BNode* node);
+template<typename Key, typename Compare>
+struct TreeTraversal {
+    TreeTraversal(const BasicTree<Key, Compare>& tree, TreeOrder order);
+
+    /** @brief Очередной узел или nullptr, если обход завершен */
+    const BasicNode<Key>* next();
+
+private:
+    const BasicTree<Key, Compare>& tree;
+    TreeOrder order;
+    BNodeIndex current = NO_NODE;
+    std::deque<BNodeIndex> queue;
+};
 
 /**
  * @brief Удаляет узел с заданным ключом из дерева.
@@ -144,42 +400,190 @@ BNode* findInOrderSuccessor(BNode* node);
  *  1. Узел - лист: просто удаляется
  *  2. Узел имеет одного потомка: потомок заменяет узел
  *  3. Узел имеет двух потомков: заменяется на предшественника/преемника
+ * В сбалансированном режиме после удаления восстанавливается баланс AVL.
  * 
  * @param tree Указатель на дерево
  * @param key Ключ узла для удаления
  */
-void deleteNode(BTree* tree, int key);
+template<typename Key, typename Compare>
+void deleteNode(BasicTree<Key, Compare>* tree, const Key& key);
 
 /**
- * @brief Считает количество внутренних узлов в поддереве.
+ * @brief Проверяет, является ли дерево полным (full tree).
  * 
- * Внутренний узел - это узел, который не является листом.
+ * Полное дерево - это дерево, в котором каждый узел имеет либо 0, либо 2 потомков.
+ * Используется для проверки команды TCHECK. Работает за O(1) по счетчикам
+ * BasicTree::nodesByChildren.
  * 
- * @param currentNode Корень поддерева
- * @return Количество внутренних узлов
+ * @param tree Ссылка на дерево
+ * @return true если дерево полное, false иначе
  */
-int countInnerNodes(BNode* currentNode);
+template<typename Key, typename Compare>
+bool isFullTree(const BasicTree<Key, Compare>& tree);
 
 /**
- * @brief Считает количество листовых узлов в поддереве.
- * 
- * Листовой узел - это узел без потомков.
- * 
- * @param currentNode Корень поддерева
- * @return Количество листовых узлов
+ * @brief Количество листьев дерева за O(1).
+ * @param tree Ссылка на дерево
  */
-int countLeavesNodes(BNode* currentNode);
+template<typename Key, typename Compare>
+std::size_t treeLeafCount(const BasicTree<Key, Compare>& tree);
 
 /**
- * @brief Проверяет, является ли дерево полным (full tree).
- * 
- * Полное дерево - это дерево, в котором каждый узел имеет либо 0, либо 2 потомков.
- * Используется для проверки команды TCHECK.
- * 
+ * @brief Проверяет наличие ключа (в обычном и замороженном дереве).
  * @param tree Ссылка на дерево
- * @return true если дерево полное, false иначе
+ * @param key Ключ для поиска
+ * @return true если ключ есть в дереве
  */
-bool isFullTree(const BTree& tree);
+template<typename Key, typename Compare>
+bool containsKey(const BasicTree<Key, Compare>& tree, const Key& key);
+
+/**
+ * @brief Пакетная проверка наличия ключей (TMSEARCH).
+ *
+ * Ключи упорядочиваются и разрешаются одним проходом по дереву: от найденной
+ * позиции предыдущего ключа курсор идет к преемникам, а если следующий ключ
+ * дальше примерно log2(n) шагов - спускается к нему от корня. Плотный набор
+ * ключей обходит дерево один раз (O(n + m log m)), редкий - не хуже m
+ * отдельных поисков; работает и для замороженного дерева.
+ *
+ * @param tree Ссылка на дерево
+ * @param keys Проверяемые ключи (в любом порядке, возможны повторы)
+ * @param found Результат: found[i] == 1, если keys[i] есть в дереве
+ */
+template<typename Key, typename Compare>
+void containsKeys(const BasicTree<Key, Compare>& tree, const std::vector<Key>& keys, std::vector<char>& found);
+
+/**
+ * @brief Замораживает дерево: строит рядом с узлами массив в порядке Эйтцингера.
+ *
+ * Ключи выкладываются как BFS полного дерева поиска: спуск от k к 2k или
+ * 2k + 1 выбирается сравнением без ветвления, а следующие уровни лежат
+ * в соседних строках кэша и подгружаются заранее (prefetch).
+ * Узлы и форма дерева не меняются. Повторная заморозка ничего не делает.
+ *
+ * @param tree Указатель на дерево
+ */
+template<typename Key, typename Compare>
+void freezeTree(BasicTree<Key, Compare>* tree);
+
+/**
+ * @brief Размораживает дерево: отбрасывает массив frozenKeys.
+ *
+ * Форма дерева остается той, что была до заморозки. Вызывается автоматически
+ * из addNode() и deleteNode(); для незамороженного дерева ничего не делает.
+ *
+ * @param tree Указатель на дерево
+ */
+template<typename Key, typename Compare>
+void thawTree(BasicTree<Key, Compare>* tree);
+
+/**
+ * @brief Позиция первого ключа, не меньшего key, в замороженном дереве.
+ * @param tree Замороженное дерево
+ * @param key Граница поиска
+ * @return Индекс в frozenKeys или 0, если все ключи меньше key
+ */
+template<typename Key, typename Compare>
+std::size_t frozenLowerBound(const BasicTree<Key, Compare>& tree, const Key& key);
+
+/**
+ * @brief Индекс следующего по возрастанию ключа замороженного дерева (0 - нет).
+ * @param tree Замороженное дерево
+ * @param k Индекс в frozenKeys
+ */
+template<typename Key, typename Compare>
+std::size_t frozenSuccessor(const BasicTree<Key, Compare>& tree, std::size_t k);
+
+/**
+ * @brief Индекс предыдущего по возрастанию ключа замороженного дерева (0 - нет).
+ * @param tree Замороженное дерево
+ * @param k Индекс в frozenKeys
+ */
+template<typename Key, typename Compare>
+std::size_t frozenPredecessor(const BasicTree<Key, Compare>& tree, std::size_t k);
+
+/**
+ * @brief Индекс минимального ключа замороженного дерева (0 - дерево пусто).
+ * @param tree Замороженное дерево
+ */
+template<typename Key, typename Compare>
+std::size_t frozenFirst(const BasicTree<Key, Compare>& tree);
+
+/**
+ * @brief Количество ключей в дереве за O(1).
+ * @param tree Ссылка на дерево
+ */
+template<typename Key, typename Compare>
+std::size_t treeSize(const BasicTree<Key, Compare>& tree);
+
+/**
+ * @brief Ранг ключа: количество ключей дерева, меньших key, за O(log n).
+ *
+ * Ключ не обязан присутствовать в дереве. Для присутствующего ключа ранг -
+ * его номер (с нуля) в порядке возрастания, то есть selectKey(rankKey(k)) == k.
+ *
+ * @param tree Ссылка на дерево
+ * @param key Ключ
+ * @return Количество ключей, меньших key
+ */
+template<typename Key, typename Compare>
+std::size_t rankKey(const BasicTree<Key, Compare>& tree, const Key& key);
+
+/**
+ * @brief Ключ с заданным номером (с нуля) в порядке возрастания, за O(log n).
+ * @param tree Ссылка на дерево
+ * @param k Номер ключа
+ * @return k-й наименьший ключ
+ * @throw std::runtime_error если k >= treeSize(tree)
+ */
+template<typename Key, typename Compare>
+const Key& selectKey(const BasicTree<Key, Compare>& tree, std::size_t k);
+
+/**
+ * @brief Количество ключей из [lo, hi] за O(log n) (разность рангов).
+ * @param tree Ссылка на дерево
+ * @param lo Нижняя граница (включительно)
+ * @param hi Верхняя граница (включительно)
+ */
+template<typename Key, typename Compare>
+std::size_t countRange(const BasicTree<Key, Compare>& tree, const Key& lo, const Key& hi);
+
+/**
+ * @brief Узел с наименьшим ключом, не меньшим key (NO_NODE если таких нет).
+ * @param tree Ссылка на незамороженное дерево
+ * @param key Граница поиска
+ */
+template<typename Key, typename Compare>
+BNodeIndex lowerBoundNode(const BasicTree<Key, Compare>& tree, const Key& key);
+
+/**
+ * @brief Вызывает fn(key) для всех ключей из [lo, hi] по возрастанию.
+ *
+ * Спуск к первому ключу - O(log n), дальше переходы к преемнику по
+ * ссылкам на родителей (или по индексам замороженного дерева):
+ * всего O(log n + количество ключей в диапазоне).
+ *
+ * @param tree Ссылка на дерево
+ * @param lo Нижняя граница (включительно)
+ * @param hi Верхняя граница (включительно)
+ * @param fn Обработчик ключа
+ */
+template<typename Key, typename Compare, typename Fn>
+void scanRange(const BasicTree<Key, Compare>& tree, const Key& lo, const Key& hi, Fn fn) {
+    using Tree = BasicTree<Key, Compare>;
+    if (Tree::less(hi, lo)) return;
+    if (tree.frozen) {
+        for (std::size_t k = frozenLowerBound(tree, lo); k != 0 && !Tree::less(hi, tree.frozenKeys[k]);
+             k = frozenSuccessor(tree, k)) {
+            fn(tree.frozenKeys[k]);
+        }
+        return;
+    }
+    for (BNodeIndex node = lowerBoundNode(tree, lo); node != NO_NODE && !Tree::less(hi, tree.nodes[node].key);
+         node = findInOrderSuccessor(tree, node)) {
+        fn(tree.nodes[node].key);
+    }
+}
 
 /**
  * @brief Возвращает ключ узла по его значению (используется для отладки).
@@ -188,6 +592,7 @@ bool isFullTree(const BTree& tree);
  * @param key Ключ узла для получения
  * @return Ключ узла
  */
-int tGet(BTree* tree, int key);
+template<typename Key, typename Compare>
+Key tGet(BasicTree<Key, Compare>* tree, const Key& key);
 
 #endif
\ No newline at end of file
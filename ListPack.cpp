@@ -0,0 +1,67 @@
+#include "ListPack.h"
+#include <algorithm>
+
+static ListPackLimits limits;
+
+void setListPackLimits(const ListPackLimits& newLimits) {
+    limits = newLimits;
+    limits.maxValue = std::min(limits.maxValue, ListPack::MAX_VALUE);
+}
+
+const ListPackLimits& listPackLimits() {
+    return limits;
+}
+
+bool ListPack::accepts(std::string_view value) const {
+    return count < limits.maxEntries && value.size() <= limits.maxValue;
+}
+
+std::size_t ListPack::offsetOf(std::size_t index) const {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(buf.data());
+    std::size_t offset;
+    if (index <= count / 2) {
+        offset = 0;
+        for (std::size_t i = 0; i < index; ++i) offset += data[offset] + 2;
+    } else {
+        // С конца: длина записи хранится и в ее последнем байте
+        offset = buf.size();
+        for (std::size_t i = count; i > index; --i) offset -= data[offset - 1] + 2;
+    }
+    return offset;
+}
+
+void ListPack::insert(std::size_t index, std::string_view value) {
+    std::size_t offset = offsetOf(index);
+    char len = static_cast<char>(static_cast<unsigned char>(value.size()));
+    buf.insert(offset, value.size() + 2, len);
+    buf.replace(offset + 1, value.size(), value.data(), value.size());
+    ++count;
+}
+
+void ListPack::erase(std::size_t index, std::size_t n) {
+    std::size_t offset = offsetOf(index);
+    std::size_t end = offset;
+    for (std::size_t i = 0; i < n; ++i) end += static_cast<unsigned char>(buf[end]) + 2;
+    buf.erase(offset, end - offset);
+    count -= static_cast<std::uint32_t>(n);
+}
+
+std::string_view ListPack::at(std::size_t index) const {
+    std::size_t offset = offsetOf(index);
+    return std::string_view(buf.data() + offset + 1, static_cast<unsigned char>(buf[offset]));
+}
+
+std::size_t ListPack::find(std::string_view value) const {
+    std::size_t index = 0;
+    for (std::size_t offset = 0; offset < buf.size(); ++index) {
+        std::size_t len = static_cast<unsigned char>(buf[offset]);
+        if (std::string_view(buf.data() + offset + 1, len) == value) return index;
+        offset += len + 2;
+    }
+    return npos;
+}
+
+void ListPack::clear() {
+    std::string().swap(buf);
+    count = 0;
+}
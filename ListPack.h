@@ -0,0 +1,119 @@
+#ifndef LIST_PACK_H
+#define LIST_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Пороги компактного представления списков (--list-max-entries, --list-max-value).
+ *
+ * Список хранится в ListPack, пока в нем не больше maxEntries элементов и
+ * каждый элемент не длиннее maxValue байт. maxEntries == 0 отключает
+ * компактное представление.
+ */
+struct ListPackLimits {
+    /** @brief Наибольшее число элементов в компактном представлении */
+    std::size_t maxEntries = 128;
+    /** @brief Наибольшая длина элемента в байтах (не больше ListPack::MAX_VALUE) */
+    std::size_t maxValue = 64;
+};
+
+/**
+ * @brief Задает пороги компактного представления для всех списков процесса.
+ *
+ * Должна вызываться до загрузки базы: уже заполненные списки не пересобираются.
+ * @param limits Новые пороги
+ */
+void setListPackLimits(const ListPackLimits& limits);
+
+/** @brief Текущие пороги компактного представления */
+const ListPackLimits& listPackLimits();
+
+/**
+ * @brief Компактное представление маленького списка (listpack).
+ *
+ * Все элементы лежат подряд в одном буфере: [len][байты][len] на элемент,
+ * len - один байт. Длина в конце записи позволяет идти и с конца, поэтому
+ * доступ по номеру начинается с ближайшего края. Вместо узла с указателями
+ * и объекта std::string на элемент список платит два байта, а обход - это
+ * линейный проход по буферу.
+ *
+ * Вставка и удаление сдвигают хвост буфера (O(размер буфера)), что дешево,
+ * пока список укладывается в пороги listPackLimits(); при выходе за них
+ * список переводится в узловое представление (см. ForwardList, DFList).
+ */
+class ListPack {
+public:
+    /** @brief Наибольшая длина элемента, которую позволяет однобайтовая длина */
+    static constexpr std::size_t MAX_VALUE = 255;
+    /** @brief Результат find(), если значения нет */
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    /** @brief Количество элементов */
+    std::size_t size() const { return count; }
+
+    /** @brief Байт, занятых буфером */
+    std::size_t bytes() const { return buf.capacity(); }
+
+    /**
+     * @brief Проверяет, останется ли список в пороге после вставки value.
+     * @param value Вставляемое значение
+     * @return true, если value можно вставить в компактное представление
+     */
+    bool accepts(std::string_view value) const;
+
+    /**
+     * @brief Вставляет value перед элементом index (index == size() - в конец).
+     * @param index Позиция вставки
+     * @param value Значение не длиннее MAX_VALUE
+     */
+    void insert(std::size_t index, std::string_view value);
+
+    /**
+     * @brief Удаляет n элементов, начиная с index.
+     * @param index Номер первого удаляемого элемента
+     * @param n Количество элементов (index + n <= size())
+     */
+    void erase(std::size_t index, std::size_t n = 1);
+
+    /**
+     * @brief Элемент с номером index (действителен до следующего изменения).
+     * @param index Номер элемента (меньше size())
+     */
+    std::string_view at(std::size_t index) const;
+
+    /**
+     * @brief Номер первого элемента со значением value.
+     * @return Номер элемента или npos
+     */
+    std::size_t find(std::string_view value) const;
+
+    /** @brief Удаляет все элементы и освобождает буфер */
+    void clear();
+
+    /**
+     * @brief Вызывает fn(value) для всех элементов по порядку.
+     * @param fn Обработчик элемента (std::string_view)
+     */
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        const char* p = buf.data();
+        const char* end = p + buf.size();
+        while (p < end) {
+            std::size_t len = static_cast<unsigned char>(*p);
+            fn(std::string_view(p + 1, len));
+            p += len + 2;
+        }
+    }
+
+private:
+    // Смещение записи с номером index (index == count - конец буфера)
+    std::size_t offsetOf(std::size_t index) const;
+
+    std::string buf;
+    std::uint32_t count = 0;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "MutationLog.h"
+#include "FileIO.h"
+#include <fstream>
+#include <stdexcept>
+#if !defined(_WIN32)
+#  include <unistd.h>
+#endif
+
+static std::string nextLogPath(const std::string& dbFile) {
+    return mutationLogPath(dbFile) + ".next";
+}
+
+static std::string compactSnapshotPath(const std::string& dbFile) {
+    return dbFile + ".compact";
+}
+
+// Читает заголовок "GEN <n>"; false если файла нет или заголовок поврежден
+static bool readLogGeneration(const std::string& path, std::uint64_t& generation) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    std::string line;
+    if (!std::getline(file, line) || line.compare(0, 4, "GEN ") != 0) return false;
+    generation = std::strtoull(line.c_str() + 4, nullptr, 10);
+    return true;
+}
+
+static std::string logHeader(std::uint64_t generation) {
+    return "GEN " + std::to_string(generation) + "\n";
+}
+
+MutationLog::~MutationLog() {
+    if (compactor.joinable()) compactor.join();
+    if (file) std::fclose(file);
+}
+
+std::string mutationLogPath(const std::string& dbFile) {
+    return dbFile + ".log";
+}
+
+std::vector<std::string> readMutationLog(const std::string& dbFile, std::uint64_t generation) {
+    std::vector<std::string> commands;
+    for (const std::string& path : {mutationLogPath(dbFile), nextLogPath(dbFile)}) {
+        std::uint64_t logGeneration = 0;
+        if (!readLogGeneration(path, logGeneration) || logGeneration != generation) continue;
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        while (std::getline(file, line)) {
+            if (!line.empty()) commands.push_back(line);
+        }
+        break;
+    }
+    return commands;
+}
+
+void openMutationLog(MutationLog& log, const std::string& dbFile, std::uint64_t generation) {
+    if (log.file) std::fclose(log.file);
+    log.file = nullptr;
+    log.dbFile = dbFile;
+    log.generation = generation;
+
+    std::string path = mutationLogPath(dbFile);
+    std::uint64_t logGeneration = 0;
+    // Сбой между переименованием снимка и журнала: актуальный журнал остался в .next
+    if (readLogGeneration(nextLogPath(dbFile), logGeneration) && logGeneration == generation) {
+        std::rename(nextLogPath(dbFile).c_str(), path.c_str());
+    }
+    std::remove(nextLogPath(dbFile).c_str());
+    if (!readLogGeneration(path, logGeneration) || logGeneration != generation) {
+        writeFileAtomically(path, logHeader(generation));
+    }
+
+    log.file = std::fopen(path.c_str(), "ab");
+    if (!log.file) throw std::runtime_error("Cannot open mutation log: " + path);
+    std::fseek(log.file, 0, SEEK_END);
+    log.bytes = static_cast<std::uint64_t>(std::ftell(log.file));
+    log.lastSync = std::chrono::steady_clock::now();
+    log.unsynced = false;
+}
+
+void appendMutation(MutationLog& log, const std::string& command) {
+    std::string line = command;
+    for (char& c : line) {
+        if (c == '\n' || c == '\r') c = ' ';
+    }
+    line += '\n';
+    if (std::fwrite(line.data(), 1, line.size(), log.file) != line.size()) {
+        throw std::runtime_error("Cannot write mutation log");
+    }
+    log.bytes += line.size();
+    log.unsynced = true;
+    if (log.compacting) log.rewriteBuffer += line;
+}
+
+void syncMutationLog(MutationLog& log, bool force) {
+    if (!log.file || !log.unsynced) return;
+    if (std::fflush(log.file) != 0) throw std::runtime_error("Cannot write mutation log");
+    if (log.fsync.mode == FsyncPolicy::NEVER) { log.unsynced = false; return; }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!force && log.fsync.mode == FsyncPolicy::PERIODIC &&
+        now - log.lastSync < std::chrono::milliseconds(log.fsync.intervalMs)) {
+        return;
+    }
+#if !defined(_WIN32)
+    if (::fsync(fileno(log.file)) != 0) throw std::runtime_error("Cannot sync mutation log");
+#endif
+    log.lastSync = now;
+    log.unsynced = false;
+}
+
+void beginCompaction(MutationLog& log, std::string snapshot) {
+    log.compacting = true;
+    log.compactorDone = false;
+    log.compactorFailed = false;
+    log.rewriteBuffer.clear();
+    std::string path = compactSnapshotPath(log.dbFile);
+    log.compactor = std::thread([&log, path, data = std::move(snapshot)]() {
+        try {
+            writeFileSynced(path, data);
+        } catch (...) {
+            log.compactorFailed = true;
+        }
+        log.compactorDone = true;
+    });
+}
+
+bool finishCompaction(MutationLog& log, bool wait) {
+    if (!log.compacting) return true;
+    if (!wait && !log.compactorDone) return false;
+    log.compactor.join();
+    log.compacting = false;
+    if (log.compactorFailed) {
+        log.rewriteBuffer.clear();
+        throw std::runtime_error("Cannot write compacted snapshot");
+    }
+
+    // Порядок важен: журнал нового поколения появляется на диске раньше снимка
+    std::uint64_t next = log.generation + 1;
+    writeFileSynced(nextLogPath(log.dbFile), logHeader(next) + log.rewriteBuffer);
+    log.rewriteBuffer.clear();
+#if defined(_WIN32)
+    std::remove(log.dbFile.c_str());
+#endif
+    if (std::rename(compactSnapshotPath(log.dbFile).c_str(), log.dbFile.c_str()) != 0) {
+        throw std::runtime_error("Cannot replace snapshot: " + log.dbFile);
+    }
+    openMutationLog(log, log.dbFile, next);
+    return true;
+}
+
+void removeMutationLog(MutationLog& log, const std::string& dbFile) {
+    finishCompaction(log, true);
+    if (log.file) std::fclose(log.file);
+    log.file = nullptr;
+    std::remove(mutationLogPath(dbFile).c_str());
+    std::remove(nextLogPath(dbFile).c_str());
+}
@@ -0,0 +1,153 @@
+#ifndef MUTATION_LOG_H
+#define MUTATION_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileIO.h"
+
+/**
+ * @brief Журнал мутаций (append-only) рядом с файлом базы данных.
+ *
+ * Вместо полной перезаписи базы после каждой команды мутирующие команды
+ * (MPUSH, FDEL, TINSERT, ...) дописываются в файл "<db>.log" - стоимость
+ * сохранения пропорциональна размеру изменения, а не размеру базы.
+ * При старте журнал проигрывается поверх последнего снимка.
+ *
+ * Формат журнала: первая строка "GEN <n>", далее по одной команде на строку.
+ *
+ * Поколения: снимок хранит номер поколения журнала, который начинается сразу
+ * после него (см. readDatabaseGeneration()). Журнал с другим номером считается
+ * устаревшим и не проигрывается. Уплотнение (compaction) записывает новый снимок
+ * поколения n+1 и новый журнал "<db>.log.next" с командами, выполненными за время
+ * записи снимка, после чего переименовывает сначала снимок, затем журнал.
+ * При сбое между переименованиями загрузчик находит журнал нужного поколения
+ * в "<db>.log.next", поэтому ни одна команда не теряется и не применяется дважды.
+ *
+ * Групповая фиксация: appendMutation() только дописывает команду в буфер,
+ * на диск журнал сбрасывает syncMutationLog() в точке фиксации (конец команды
+ * --query, конец скрипта, конец пачки команд сервера) - один fsync покрывает
+ * все команды пачки. Частота fsync задается политикой FsyncPolicy.
+ */
+struct MutationLog {
+    /** @brief Путь к файлу базы данных (снимку) */
+    std::string dbFile;
+    /** @brief Поколение открытого журнала */
+    std::uint64_t generation = 0;
+    /** @brief Открытый на дописывание файл журнала (nullptr если журнал не открыт) */
+    std::FILE* file = nullptr;
+    /** @brief Текущий размер журнала в байтах */
+    std::uint64_t bytes = 0;
+
+    /** @brief Политика сброса журнала на диск */
+    FsyncPolicy fsync;
+    /** @brief Время последнего fsync (для FsyncPolicy::PERIODIC) */
+    std::chrono::steady_clock::time_point lastSync;
+    /** @brief Есть команды, еще не сброшенные на диск */
+    bool unsynced = false;
+
+    /** @brief Идет ли фоновое уплотнение */
+    bool compacting = false;
+    /** @brief Поток, записывающий снимок во временный файл */
+    std::thread compactor;
+    /** @brief Поток закончил запись снимка */
+    std::atomic<bool> compactorDone{false};
+    /** @brief Запись снимка завершилась ошибкой */
+    std::atomic<bool> compactorFailed{false};
+    /** @brief Команды, выполненные после снятия снимка: попадут в журнал нового поколения */
+    std::string rewriteBuffer;
+
+    MutationLog() = default;
+    ~MutationLog();
+    MutationLog(const MutationLog&) = delete;
+    MutationLog& operator=(const MutationLog&) = delete;
+};
+
+/**
+ * @brief Возвращает путь к журналу мутаций для файла базы данных.
+ * @param dbFile Путь к файлу базы данных
+ * @return "<dbFile>.log"
+ */
+std::string mutationLogPath(const std::string& dbFile);
+
+/**
+ * @brief Читает команды журнала, относящегося к снимку заданного поколения.
+ * @param dbFile Путь к файлу базы данных
+ * @param generation Поколение, записанное в снимке
+ * @return Команды в порядке выполнения (пусто, если подходящего журнала нет)
+ */
+std::vector<std::string> readMutationLog(const std::string& dbFile, std::uint64_t generation);
+
+/**
+ * @brief Открывает журнал на дописывание.
+ *
+ * Если журнал поколения generation уже существует, новые команды дописываются
+ * в его конец, иначе создается пустой журнал этого поколения.
+ *
+ * @param log Журнал
+ * @param dbFile Путь к файлу базы данных
+ * @param generation Поколение, записанное в загруженном снимке
+ * @throw std::runtime_error если файл журнала не удалось открыть
+ */
+void openMutationLog(MutationLog& log, const std::string& dbFile, std::uint64_t generation);
+
+/**
+ * @brief Дописывает выполненную мутирующую команду в журнал.
+ *
+ * Команда попадает в буфер файла; на диск ее сбрасывает syncMutationLog().
+ *
+ * @param log Открытый журнал
+ * @param command Команда (переводы строк заменяются пробелами)
+ * @throw std::runtime_error при ошибке записи
+ */
+void appendMutation(MutationLog& log, const std::string& command);
+
+/**
+ * @brief Точка фиксации: передает дописанные команды ОС и при необходимости вызывает fsync.
+ *
+ * ALWAYS - fsync при каждом вызове, PERIODIC - если с прошлого fsync прошло
+ * не меньше интервала, NEVER - без fsync.
+ *
+ * @param log Журнал
+ * @param force Вызвать fsync независимо от интервала (кроме NEVER), например при завершении процесса
+ * @throw std::runtime_error при ошибке записи
+ */
+void syncMutationLog(MutationLog& log, bool force);
+
+/**
+ * @brief Запускает уплотнение журнала.
+ *
+ * Снимок уже сериализован вызывающей стороной (в памяти, с поколением
+ * log.generation + 1); фоновый поток записывает его во временный файл,
+ * а команды продолжают дописываться в текущий журнал и в rewriteBuffer.
+ *
+ * @param log Открытый журнал (уплотнение не должно уже идти)
+ * @param snapshot Содержимое нового снимка
+ */
+void beginCompaction(MutationLog& log, std::string snapshot);
+
+/**
+ * @brief Завершает уплотнение, если снимок уже записан.
+ *
+ * Записывает журнал нового поколения, переименовывает снимок и журнал
+ * на место старых и переключает дописывание на новый журнал.
+ *
+ * @param log Журнал
+ * @param wait Дождаться окончания записи снимка, если она еще идет
+ * @return true если уплотнения нет или оно завершено, false если снимок еще пишется
+ * @throw std::runtime_error если запись снимка или переименование завершились ошибкой
+ */
+bool finishCompaction(MutationLog& log, bool wait);
+
+/**
+ * @brief Закрывает журнал и удаляет его файлы (используется после полной перезаписи базы).
+ * @param log Журнал
+ * @param dbFile Путь к файлу базы данных
+ */
+void removeMutationLog(MutationLog& log, const std::string& dbFile);
+
+#endif
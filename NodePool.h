@@ -0,0 +1,154 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Статистика пула узлов (команды FMEM, LMEM, SMEM, QMEM).
+ *
+ * capacity - live - free узлов еще ни разу не выдавались (хвост последнего блока).
+ */
+struct NodePoolStats {
+    /** @brief Количество блоков (slab) */
+    std::size_t slabs = 0;
+    /** @brief Узлов во всех блоках */
+    std::size_t capacity = 0;
+    /** @brief Занятых узлов */
+    std::size_t live = 0;
+    /** @brief Освобожденных узлов в списке свободных */
+    std::size_t free = 0;
+    /** @brief Байт, занятых блоками */
+    std::size_t bytes = 0;
+};
+
+/**
+ * @brief Пул узлов списка: узлы выдаются из блоков (slab), а не по одному через new.
+ *
+ * Каждый список владеет своим пулом, поэтому структуры по-прежнему можно
+ * загружать и сохранять параллельно без блокировок. Узлы одного типа имеют
+ * один размер, так что пул - это один размерный класс: освобожденный узел
+ * попадает в список свободных, связанный через сами ячейки, и выдается
+ * следующим. Новый блок вдвое больше предыдущего (от SLAB_MIN до SLAB_MAX
+ * узлов, около 1 КиБ и 256 КиБ): маленький список не резервирует лишнего,
+ * а длинный делает O(log n) выделений вместо n.
+ *
+ * Удаление всего списка (releaseAll()) вызывает деструкторы узлов и
+ * освобождает блоки целиком, без free() на каждый узел.
+ *
+ * @tparam Node Тип узла со ссылкой next (FNode, DFNode)
+ */
+template<typename Node>
+class NodePool {
+public:
+    /** @brief Размер первого блока в узлах */
+    static constexpr std::size_t SLAB_MIN = sizeof(Node) >= 1024 ? 1 : 1024 / sizeof(Node);
+    /** @brief Наибольший размер блока в узлах */
+    static constexpr std::size_t SLAB_MAX = sizeof(Node) >= 256 * 1024 ? 1 : 256 * 1024 / sizeof(Node);
+
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    /**
+     * @brief Создает узел в свободной ячейке: Node{args...}.
+     * @return Указатель на узел
+     */
+    template<typename... Args>
+    Node* create(Args&&... args) {
+        Slot* slot = acquire();
+        try {
+            Node* node = new (slot->storage) Node{std::forward<Args>(args)...};
+            ++live;
+            return node;
+        } catch (...) {
+            slot->nextFree = freeList;
+            freeList = slot;
+            ++freeCount;
+            throw;
+        }
+    }
+
+    /**
+     * @brief Уничтожает узел и возвращает его ячейку в список свободных.
+     * @param node Узел, выданный этим пулом
+     */
+    void destroy(Node* node) {
+        node->~Node();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->nextFree = freeList;
+        freeList = slot;
+        ++freeCount;
+        --live;
+    }
+
+    /**
+     * @brief Уничтожает цепочку узлов head -> next -> ... и освобождает все блоки.
+     *
+     * Цепочка должна содержать все живые узлы пула (весь список).
+     * @param head Первый узел списка (nullptr для пустого)
+     */
+    void releaseAll(Node* head) {
+        while (head) {
+            Node* next = head->next;
+            head->~Node();
+            head = next;
+        }
+        std::vector<Slab>().swap(slabs);
+        freeList = nullptr;
+        freeCount = 0;
+        live = 0;
+        used = 0;
+    }
+
+    /** @brief Текущая статистика пула */
+    NodePoolStats stats() const {
+        NodePoolStats s;
+        s.slabs = slabs.size();
+        for (const Slab& slab : slabs) s.capacity += slab.count;
+        s.live = live;
+        s.free = freeCount;
+        s.bytes = s.capacity * sizeof(Slot);
+        return s;
+    }
+
+private:
+    // Ячейка блока: свободная хранит ссылку на следующую свободную, занятая - узел
+    union Slot {
+        Slot* nextFree;
+        alignas(Node) unsigned char storage[sizeof(Node)];
+    };
+
+    struct Slab {
+        std::unique_ptr<Slot[]> slots;
+        std::size_t count;
+    };
+
+    Slot* acquire() {
+        if (freeList) {
+            Slot* slot = freeList;
+            freeList = slot->nextFree;
+            --freeCount;
+            return slot;
+        }
+        if (slabs.empty() || used == slabs.back().count) {
+            std::size_t count = slabs.empty() ? SLAB_MIN : slabs.back().count * 2;
+            if (count > SLAB_MAX) count = SLAB_MAX;
+            slabs.push_back(Slab{std::unique_ptr<Slot[]>(new Slot[count]), count});
+            used = 0;
+        }
+        return &slabs.back().slots[used++];
+    }
+
+    std::vector<Slab> slabs;
+    /** @brief Выдано ячеек из последнего блока */
+    std::size_t used = 0;
+    Slot* freeList = nullptr;
+    std::size_t freeCount = 0;
+    std::size_t live = 0;
+};
+
+#endif
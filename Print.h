@@ -9,18 +9,21 @@
 #include "DoubleList.h"
 #include "Array.h"
 #include "FullBinaryTree.h"
+#include "BPlusTree.h"
+
+/** Элементы ForwardList через ", " (общая часть PRINT для списка, стека и очереди) */
+inline void printFLItems(const ForwardList* list) {
+    const char* separator = "";
+    forEachFL(list, [&](std::string_view key) {
+        std::cout << separator << key;
+        separator = ", ";
+    });
+}
 
 inline void PRINT(const Stack& stack) {
     std::cout << "Stack (size: " << stack.size << "): [";
     if (stack.list) {
-        FNode* current = stack.list->head;
-        while (current != nullptr) {
-            std::cout << current->key;
-            if (current->next != nullptr) {
-                std::cout << ", ";
-            }
-            current = current->next;
-        }
+        printFLItems(stack.list);
     }
     std::cout << "]" << std::endl;
 }
@@ -28,41 +31,24 @@ inline void PRINT(const Stack& stack) {
 inline void PRINT(const Queue& queue) {
     std::cout << "Queue (size: " << queue.size << "): [";
     if (queue.list) {
-        FNode* current = queue.list->head;
-        while (current != nullptr) {
-            std::cout << current->key;
-            if (current->next != nullptr) {
-                std::cout << ", ";
-            }
-            current = current->next;
-        }
+        printFLItems(queue.list);
     }
     std::cout << "]" << std::endl;
 }
 
 inline void PRINT(const ForwardList& list) {
     std::cout << "ForwardList (size: " << list.size << "): [";
-    FNode* current = list.head;
-    while (current != nullptr) {
-        std::cout << current->key;
-        if (current->next != nullptr) {
-            std::cout << ", ";
-        }
-        current = current->next;
-    }
+    printFLItems(&list);
     std::cout << "]" << std::endl;
 }
 
 inline void PRINT(const DFList& list) {
     std::cout << "DoubleLinkedList (size: " << list.length << "): [";
-    DFNode* current = list.head;
-    while (current != nullptr) {
-        std::cout << current->key;
-        if (current->next != nullptr) {
-            std::cout << ", ";
-        }
-        current = current->next;
-    }
+    const char* separator = "";
+    forEachDFList(&list, [&](std::string_view key) {
+        std::cout << separator << key;
+        separator = ", ";
+    });
     std::cout << "]" << std::endl;
 }
 
@@ -77,17 +63,31 @@ inline void PRINT(const Array& array) {
     std::cout << "]" << std::endl;
 }
 
-inline void printBTreeHelper(BNode* node) {
-    if (node != nullptr) {
-        printBTreeHelper(node->left);
+template<typename Key, typename Compare>
+void printBTreeHelper(const BasicTree<Key, Compare>& tree) {
+    TreeTraversal walk(tree, TreeOrder::IN);
+    while (const auto* node = walk.next()) {
         std::cout << node->key << " " << std::endl;
-        printBTreeHelper(node->right);
     }
 }
 
-inline void PRINT(const BTree& tree) {
+template<typename Key, typename Compare>
+void PRINT(const BasicTree<Key, Compare>& tree) {
     std::cout << "FBTree: [";
-    printBTreeHelper(tree.root);
+    printBTreeHelper(tree);
+    std::cout << "]" << std::endl;
+}
+
+inline void PRINT(const BPlusTree& tree) {
+    std::cout << "BPlusTree (size: " << tree.size << "): [";
+    for (const BPlusLeaf* leaf = tree.first; leaf; leaf = leaf->next) {
+        for (int i = 0; i < leaf->count; ++i) {
+            std::cout << leaf->keys[i];
+            if (i + 1 < leaf->count || leaf->next != nullptr) {
+                std::cout << ", ";
+            }
+        }
+    }
     std::cout << "]" << std::endl;
 }
 
@@ -1,6 +1,6 @@
 
 #include "Queue.h"
-#include <sstream>
+#include "BinaryFormat.h"
 
 using namespace std;
 
@@ -28,7 +28,7 @@ void enqueue(Queue* queue, const string& value) {
 }
 
 string dequeue(Queue* queue) {
-    if (!queue->list || queue->list->head == nullptr) {
+    if (!queue->list || isEmptyFL(queue->list)) {
         throw underflow_error("Очередь пустая");
     }
     string val = frontFL(queue->list);
@@ -38,7 +38,7 @@ string dequeue(Queue* queue) {
 }
 
 string frontQueue(const Queue* queue) {
-    if (!queue->list || queue->list->head == nullptr) {
+    if (!queue->list || isEmptyFL(queue->list)) {
         throw underflow_error("Очередь пустая");
     }
     return frontFL(queue->list);
@@ -58,36 +58,52 @@ size_t getQueueSize(const Queue* queue) {
 
 void clearQueue(Queue* queue) {
     if (!queue->list) return;
-    while (!isEmptyFL(queue->list)) popFrontFL(queue->list);
+    clearFL(queue->list);
     queue->size = 0;
 }
 
-std::string Queue::serialize() const {
-    std::ostringstream oss;
-    oss << "Q " << name << " " << size;
-    if (list && list->head) {
-        FNode* cur = list->head;
-        while (cur) {
-            oss << " " << cur->key;
-            cur = cur->next;
-        }
+void Queue::serializeTo(Writer& out) const {
+    out.write("Q ");
+    out.write(name);
+    out.put(' ');
+    out.writeNumber(size);
+    if (list) {
+        forEachFL(list, [&](std::string_view key) {
+            out.put(' ');
+            out.write(key);
+        });
     }
-    return oss.str();
 }
 
-void Queue::deserialize(const std::string& data) {
-    std::istringstream iss(data);
-    std::string type;
-    iss >> type; // Q
-    iss >> name;
-    int count = 0;
-    iss >> count;
+void Queue::deserializeFrom(std::string_view data) {
+    TextReader in(data);
+    in.next(); // Q
+    name = std::string(in.next());
+    std::uint64_t count = in.nextNumber<std::uint64_t>();
     if (!list) list = createFL();
-    while (!isEmptyFL(list)) popFrontFL(list);
+    clearFL(list);
     size = 0;
-    for (int i = 0; i < count; ++i) {
-        std::string v; iss >> v;
-        pushBackFL(list, v);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        pushBackFL(list, std::string(in.next()));
         size++;
     }
-}
\ No newline at end of file
+}
+
+void Queue::serializeBinary(std::string& out) const {
+    appendU64(out, size);
+    if (list) {
+        forEachFL(list, [&](std::string_view key) { appendString(out, key); });
+    }
+}
+
+void Queue::deserializeBinary(const char* data, std::size_t dataSize) {
+    BinaryReader in(data, dataSize);
+    std::uint64_t count = in.readU64();
+    if (!list) list = createFL();
+    clearFL(list);
+    size = 0;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        pushBackFL(list, in.readString());
+        size++;
+    }
+}
@@ -37,15 +37,28 @@ struct Queue : public Structure {
      * @brief Сериализует очередь в формат: "Q name count front ... back"
      * 
      * Формат: первый элемент - фронт очереди, последний - конец.
-     * @return Строка с сохраненным состоянием очереди
+     * @param out Буфер записи, в который дописывается строка
      */
-    std::string serialize() const override;
+    void serializeTo(Writer& out) const override;
     
     /**
      * @brief Десериализует очередь из строки формата "Q name count front ... back"
      * @param data Строка с сохраненными данными очереди
      */
-    void deserialize(const std::string& data) override;
+    void deserializeFrom(std::string_view data) override;
+
+    /**
+     * @brief Записывает очередь в бинарной форме: uint64 count, затем элементы от фронта к концу
+     * @param out Буфер для дописывания данных
+     */
+    void serializeBinary(std::string& out) const override;
+
+    /**
+     * @brief Восстанавливает очередь из бинарной формы
+     * @param data Начало полезной нагрузки
+     * @param size Длина полезной нагрузки в байтах
+     */
+    void deserializeBinary(const char* data, std::size_t size) override;
 };
 
 /**
@@ -0,0 +1,232 @@
+#include "Server.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#if !defined(_WIN32)
+#  include <cerrno>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+void requestServerStop() {
+    stopRequested = 1;
+}
+
+#if defined(_WIN32)
+
+void runServer(const std::string&, const ServerHooks&, int) {
+    throw std::runtime_error("Unix sockets are not supported on this platform");
+}
+
+bool sendServerCommand(const std::string&, const std::string&, std::string&) {
+    throw std::runtime_error("Unix sockets are not supported on this platform");
+}
+
+#else
+
+static void onStopSignal(int) {
+    stopRequested = 1;
+}
+
+static sockaddr_un makeAddress(const std::string& socketPath) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path is too long");
+    }
+    std::strcpy(addr.sun_path, socketPath.c_str());
+    return addr;
+}
+
+static bool writeAll(int fd, const char* data, std::size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+static void appendResponse(std::string& out, bool ok, const std::string& payload) {
+    out += ok ? "OK " : "ERROR ";
+    out += std::to_string(payload.size());
+    out += '\n';
+    out += payload;
+}
+
+/**
+ * Состояние одного подключения: недочитанный хвост входного потока
+ * и накопленные, но еще не отправленные ответы.
+ */
+struct ClientConn {
+    int fd = -1;
+    std::string in;
+    std::string out;
+    bool closing = false;
+};
+
+/**
+ * Закрывает подключения и слушающий сокет и удаляет файл сокета при выходе
+ * из runServer(), в том числе по исключению из обработчиков.
+ */
+struct ServerCleanup {
+    int listenFd;
+    const std::string& socketPath;
+    std::vector<ClientConn>& clients;
+    ~ServerCleanup() {
+        for (ClientConn& c : clients) close(c.fd);
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+};
+
+void runServer(const std::string& socketPath, const ServerHooks& hooks, int idleTimeoutMs) {
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) throw std::runtime_error("Cannot create socket");
+
+    sockaddr_un addr = makeAddress(socketPath);
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listenFd, 64) != 0) {
+        close(listenFd);
+        throw std::runtime_error("Cannot bind socket: " + socketPath);
+    }
+
+    stopRequested = 0;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<ClientConn> clients;
+    ServerCleanup cleanup{listenFd, socketPath, clients};
+    std::vector<pollfd> fds;
+    char buf[64 * 1024];
+
+    while (!stopRequested) {
+        fds.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        for (const ClientConn& c : clients) fds.push_back({c.fd, POLLIN, 0});
+
+        int ready = poll(fds.data(), fds.size(), idleTimeoutMs);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready == 0) {
+            if (hooks.onBatchEnd) hooks.onBatchEnd();
+            continue;
+        }
+
+        // Читаем все готовые подключения и выполняем все пришедшие целиком команды
+        for (std::size_t i = 1; i < fds.size(); ++i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ClientConn& c = clients[i - 1];
+            ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                c.closing = true;
+                continue;
+            }
+            c.in.append(buf, static_cast<std::size_t>(n));
+
+            std::size_t start = 0, eol;
+            while ((eol = c.in.find('\n', start)) != std::string::npos) {
+                std::string line = c.in.substr(start, eol - start);
+                start = eol + 1;
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.empty()) continue;
+                if (line == "QUIT") { c.closing = true; break; }
+                std::string output;
+                bool ok = hooks.onCommand(line, output);
+                appendResponse(c.out, ok, output);
+                if (stopRequested) break;
+            }
+            c.in.erase(0, start);
+        }
+
+        // Сохранение выполняется до отправки ответов: клиент получает ответ
+        // только после того, как сработала политика сохранения
+        if (hooks.onBatchEnd) hooks.onBatchEnd();
+
+        for (ClientConn& c : clients) {
+            if (!c.out.empty()) {
+                if (!writeAll(c.fd, c.out.data(), c.out.size())) c.closing = true;
+                c.out.clear();
+            }
+        }
+
+        for (std::size_t i = 0; i < clients.size();) {
+            if (clients[i].closing) {
+                close(clients[i].fd);
+                clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i));
+            } else {
+                ++i;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                ClientConn c;
+                c.fd = fd;
+                clients.push_back(c);
+            }
+        }
+    }
+}
+
+bool sendServerCommand(const std::string& socketPath, const std::string& line, std::string& output) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("Cannot create socket");
+    sockaddr_un addr = makeAddress(socketPath);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::string reason = std::strerror(errno);
+        close(fd);
+        throw std::runtime_error("Cannot connect to " + socketPath + ": " + reason);
+    }
+
+    std::string request = line + "\n";
+    if (!writeAll(fd, request.data(), request.size())) {
+        close(fd);
+        throw std::runtime_error("Connection lost");
+    }
+
+    // Ответ: строка статуса "OK <n>" / "ERROR <n>", затем n байт вывода
+    std::string in;
+    char buf[64 * 1024];
+    std::size_t headerEnd = std::string::npos;
+    std::size_t expected = 0;
+    while (true) {
+        if (headerEnd == std::string::npos) {
+            headerEnd = in.find('\n');
+            if (headerEnd != std::string::npos) {
+                std::size_t space = in.find(' ');
+                expected = std::stoul(in.substr(space + 1, headerEnd - space - 1));
+            }
+        }
+        if (headerEnd != std::string::npos && in.size() >= headerEnd + 1 + expected) break;
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            throw std::runtime_error("Connection lost");
+        }
+        in.append(buf, static_cast<std::size_t>(n));
+    }
+    close(fd);
+
+    output = in.substr(headerEnd + 1, expected);
+    return in.compare(0, 3, "OK ") == 0;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <functional>
+#include <string>
+
+/**
+ * @brief Резидентный режим: долгоживущий процесс, принимающий команды через Unix-сокет.
+ *
+ * Модуль отвечает только за транспорт: принимает подключения, режет входящий
+ * поток на строки-команды и отправляет ответы. Выполнение команд и политика
+ * сохранения базы данных задаются вызывающей стороной через ServerHooks.
+ *
+ * Протокол (одна команда на строку, ответы в порядке поступления команд):
+ *  -> "MPUSH arr 10\n"
+ *  <- "OK <n>\n" + n байт вывода команды
+ *  <- "ERROR <n>\n" + n байт сообщения об ошибке (например "ERROR 20: Structure not found\n")
+ */
+
+/**
+ * @brief Обработчики событий сервера.
+ */
+struct ServerHooks {
+    /**
+     * @brief Выполняет одну команду.
+     * @param line Строка команды без завершающего '\n'
+     * @param output Вывод команды (то, что в режиме --query попало бы в stdout/stderr)
+     * @return true если команда выполнена успешно, false если произошла ошибка
+     */
+    std::function<bool(const std::string& line, std::string& output)> onCommand;
+
+    /**
+     * @brief Вызывается после обработки очередной пачки команд (до отправки ответов)
+     * и по таймауту ожидания, если команд не было. Используется для отложенного сохранения.
+     */
+    std::function<void()> onBatchEnd;
+};
+
+/**
+ * @brief Запускает цикл обработки подключений на Unix-сокете.
+ *
+ * Блокирует вызывающий поток до вызова requestServerStop() (команда SHUTDOWN,
+ * сигналы SIGINT/SIGTERM). Существующий файл сокета по пути socketPath заменяется.
+ *
+ * @param socketPath Путь к файлу Unix-сокета
+ * @param hooks Обработчики команд и окончания пачки
+ * @param idleTimeoutMs Период вызова onBatchEnd при отсутствии команд (мс)
+ * @throw std::runtime_error если сокет не удалось создать (или платформа не поддерживается)
+ */
+void runServer(const std::string& socketPath, const ServerHooks& hooks, int idleTimeoutMs = 1000);
+
+/**
+ * @brief Просит runServer завершиться после обработки текущей пачки команд.
+ *
+ * Безопасна для вызова из обработчика сигнала.
+ */
+void requestServerStop();
+
+/**
+ * @brief Отправляет одну команду запущенному серверу и ждет ответа.
+ * @param socketPath Путь к файлу Unix-сокета сервера
+ * @param line Команда
+ * @param output Вывод команды
+ * @return true если сервер выполнил команду успешно, false если вернул ошибку
+ * @throw std::runtime_error если подключиться к серверу не удалось
+ */
+bool sendServerCommand(const std::string& socketPath, const std::string& line, std::string& output);
+
+#endif
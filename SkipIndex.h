@@ -0,0 +1,239 @@
+#ifndef SKIP_INDEX_H
+#define SKIP_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Верхние уровни узла в позиционном индексе (SkipIndex).
+ *
+ * Уровень 0 - сам список (next/prev узла), здесь хранятся уровни 1..height.
+ */
+template<typename Node>
+struct SkipTower {
+    /** @brief Ссылки узла на одном уровне */
+    struct Level {
+        /** @brief Следующий узел этого уровня (nullptr - последний) */
+        Node* next = nullptr;
+        /** @brief Предыдущий узел этого уровня (nullptr - голова индекса) */
+        Node* prev = nullptr;
+        /** @brief Элементов от начала этого узла до начала next (до конца списка, если next нет) */
+        std::size_t span = 0;
+    };
+
+    explicit SkipTower(int h) : height(h), levels(new Level[h]) {}
+
+    /** @brief Число верхних уровней узла */
+    int height;
+    /** @brief levels[i] - уровень i + 1 */
+    std::unique_ptr<Level[]> levels;
+};
+
+/**
+ * @brief Позиционный индекс списка: skip list со счетчиками элементов (span).
+ *
+ * Нижний уровень - сам список, поэтому обход по порядку по-прежнему идет
+ * по next и индекс не трогает. Узел получает случайную высоту (уровень k
+ * с вероятностью 4^-k), башня верхних уровней хранится в узле (поле tower).
+ * span ссылки - сколько элементов лежит от начала узла до начала следующего
+ * узла этого уровня, поэтому элемент с номером i находится спуском с
+ * верхнего уровня за O(log n) ожидаемых шагов.
+ *
+ * Изменения сообщаются индексу по узлам: inserted() - узел вставлен в список,
+ * removed() - узел еще в списке, но будет отцеплен, addWeight() - в узле
+ * изменилось число элементов. Ссылки на уровни, проходящие над узлом,
+ * находятся подъемом назад от узла (по prev уровней), тоже за O(log n),
+ * поэтому обновление не требует знать позицию узла.
+ *
+ * Пока индекс не построен (built() == false), все уведомления - пустые
+ * операции и у узлов нет башен. Список строит индекс лениво, при первом
+ * позиционном доступе к длинному списку (не короче MIN_WEIGHT элементов).
+ *
+ * Требования к Node: поля next, prev (уровень 0), std::unique_ptr<SkipTower<Node>> tower
+ * и функция skipWeight(const Node*) - число элементов в узле.
+ *
+ * @tparam Node Тип узла списка (FNode, DFNode)
+ */
+template<typename Node>
+class SkipIndex {
+public:
+    /** @brief Уровней в голове индекса; высота узла не больше MAX_LEVEL - 1 */
+    static constexpr int MAX_LEVEL = 16;
+    /** @brief Минимальное число элементов списка, при котором индекс строится */
+    static constexpr std::size_t MIN_WEIGHT = 64;
+
+    using Level = typename SkipTower<Node>::Level;
+
+    /** @brief Индекс построен и поддерживается */
+    bool built() const { return isBuilt; }
+
+    /**
+     * @brief Строит индекс над списком, у узлов которого нет башен.
+     * @param first Первый узел списка
+     */
+    void build(Node* first) {
+        Node* last[MAX_LEVEL + 1] = {};
+        std::size_t lastRank[MAX_LEVEL + 1] = {};
+        head.reset(new Level[MAX_LEVEL]);
+        std::size_t rank = 0;
+        for (Node* node = first; node; node = node->next) {
+            int h = randomHeight();
+            if (h) node->tower.reset(new SkipTower<Node>(h));
+            for (int L = 1; L <= h; ++L) {
+                Level& p = at(last[L], L);
+                p.next = node;
+                p.span = rank - lastRank[L];
+                node->tower->levels[L - 1].prev = last[L];
+                last[L] = node;
+                lastRank[L] = rank;
+            }
+            rank += skipWeight(node);
+        }
+        for (int L = 1; L <= MAX_LEVEL; ++L) at(last[L], L).span = rank - lastRank[L];
+        isBuilt = true;
+    }
+
+    /**
+     * @brief Удаляет башни узлов; индекс будет построен заново при необходимости.
+     * @param first Первый узел списка
+     */
+    void reset(Node* first) {
+        if (!isBuilt) return;
+        for (Node* node = first; node; node = node->next) node->tower.reset();
+        forget();
+    }
+
+    /** @brief Узлы списка уже уничтожены вместе с башнями (очистка списка) */
+    void forget() {
+        head.reset();
+        isBuilt = false;
+    }
+
+    /**
+     * @brief Находит узел, содержащий элемент с номером index.
+     * @param first Первый узел списка
+     * @param index Номер элемента (меньше числа элементов); на выходе - номер внутри узла
+     * @return Узел с элементом
+     */
+    Node* locate(Node* first, std::size_t& index) const {
+        Node* node = nullptr;
+        std::size_t rank = 0;
+        for (int L = MAX_LEVEL; L >= 1; --L) {
+            for (;;) {
+                const Level& l = at(node, L);
+                if (!l.next || rank + l.span > index) break;
+                rank += l.span;
+                node = l.next;
+            }
+        }
+        if (!node) node = first;
+        while (rank + skipWeight(node) <= index) {
+            rank += skipWeight(node);
+            node = node->next;
+        }
+        index -= rank;
+        return node;
+    }
+
+    /** @brief Узел node вставлен в список (next/prev уже связаны, элементы учитываются) */
+    void inserted(Node* node) {
+        if (!isBuilt) return;
+        Node* pred[MAX_LEVEL + 1];
+        std::size_t dist[MAX_LEVEL + 1];
+        predecessors(node, pred, dist);
+        std::size_t w = skipWeight(node);
+        int h = randomHeight();
+        if (h) node->tower.reset(new SkipTower<Node>(h));
+        for (int L = 1; L <= h; ++L) {
+            Level& p = at(pred[L], L);
+            Level& n = node->tower->levels[L - 1];
+            n.next = p.next;
+            n.prev = pred[L];
+            if (n.next) n.next->tower->levels[L - 1].prev = node;
+            p.next = node;
+            n.span = p.span - dist[L] + w;
+            p.span = dist[L];
+        }
+        for (int L = h + 1; L <= MAX_LEVEL; ++L) at(pred[L], L).span += w;
+    }
+
+    /** @brief Узел node будет отцеплен от списка (сейчас он еще связан) */
+    void removed(Node* node) {
+        if (!isBuilt) return;
+        Node* pred[MAX_LEVEL + 1];
+        std::size_t dist[MAX_LEVEL + 1];
+        predecessors(node, pred, dist);
+        std::size_t w = skipWeight(node);
+        int h = height(node);
+        for (int L = 1; L <= h; ++L) {
+            Level& n = node->tower->levels[L - 1];
+            Level& p = at(n.prev, L);
+            p.next = n.next;
+            if (n.next) n.next->tower->levels[L - 1].prev = n.prev;
+            p.span += n.span - w;
+        }
+        for (int L = h + 1; L <= MAX_LEVEL; ++L) at(pred[L], L).span -= w;
+        node->tower.reset();
+    }
+
+    /** @brief Число элементов узла node изменилось на delta */
+    void addWeight(Node* node, std::ptrdiff_t delta) {
+        if (!isBuilt || delta == 0) return;
+        Node* pred[MAX_LEVEL + 1];
+        std::size_t dist[MAX_LEVEL + 1];
+        predecessors(node, pred, dist);
+        int h = height(node);
+        for (int L = 1; L <= h; ++L) node->tower->levels[L - 1].span += delta;
+        for (int L = h + 1; L <= MAX_LEVEL; ++L) at(pred[L], L).span += delta;
+    }
+
+private:
+    static int height(const Node* node) { return node->tower ? node->tower->height : 0; }
+
+    Level& at(Node* node, int L) { return node ? node->tower->levels[L - 1] : head[L - 1]; }
+    const Level& at(const Node* node, int L) const { return node ? node->tower->levels[L - 1] : head[L - 1]; }
+
+    /*
+     * Для уровней L > height(node): pred[L] - ближайший узел перед node, у
+     * которого есть уровень L (nullptr - голова индекса), dist[L] - элементов
+     * от начала pred[L] до начала node (от начала списка для головы). Именно
+     * ссылка pred[L] на уровне L проходит над node.
+     */
+    void predecessors(const Node* node, Node** pred, std::size_t* dist) const {
+        const Node* cur = node;
+        std::size_t acc = 0;
+        for (int L = height(node); L < MAX_LEVEL; ++L) {
+            // cur имеет уровень L; назад по уровню L до узла с уровнем L + 1
+            while (cur && height(cur) <= L) {
+                Node* p = L == 0 ? cur->prev : cur->tower->levels[L - 1].prev;
+                if (p) acc += L == 0 ? skipWeight(p) : p->tower->levels[L - 1].span;
+                else if (L > 0) acc += head[L - 1].span;
+                cur = p;
+            }
+            pred[L + 1] = const_cast<Node*>(cur);
+            dist[L + 1] = acc;
+        }
+    }
+
+    // Уровень k (1..MAX_LEVEL - 1) с вероятностью 4^-k: xorshift64
+    int randomHeight() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        std::uint64_t bits = seed;
+        int h = 0;
+        while (h < MAX_LEVEL - 1 && (bits & 3) == 0) {
+            ++h;
+            bits >>= 2;
+        }
+        return h;
+    }
+
+    /** @brief Уровни головы индекса: head[i] - уровень i + 1 (выделяются при построении) */
+    std::unique_ptr<Level[]> head;
+    bool isBuilt = false;
+    std::uint64_t seed = 0x9E3779B97F4A7C15ull;
+};
+
+#endif
@@ -1,5 +1,5 @@
 #include "Stack.h"
-#include <sstream>
+#include "BinaryFormat.h"
 using namespace std;
 
 void initializeStack(Stack* stack) {
@@ -17,7 +17,7 @@ void pushStack(Stack* stack, const string& data) {
 }
 
 string popStack(Stack* stack) {
-    if (!stack->list || !stack->list->head) {
+    if (!stack->list || isEmptyFL(stack->list)) {
         throw underflow_error("Стек пустой");
     }
     string val = frontFL(stack->list);
@@ -27,7 +27,7 @@ string popStack(Stack* stack) {
 }
 
 string peekStack(const Stack* stack) {
-    if (!stack->list || !stack->list->head) {
+    if (!stack->list || isEmptyFL(stack->list)) {
         throw underflow_error("Стек пустой");
     }
     return frontFL(stack->list);
@@ -47,7 +47,7 @@ size_t getStackSize(const Stack* stack) {
 
 void clearStack(Stack* stack) {
     if (!stack->list) return;
-    while (!isEmptyFL(stack->list)) popFrontFL(stack->list);
+    clearFL(stack->list);
     stack->size = 0;
 }
 
@@ -60,18 +60,18 @@ void clearStack(Stack* stack) {
  * В ForwardList head указывает на первый элемент, который в контексте стека
  * является вершиной (top of stack).
  */
-std::string Stack::serialize() const {
-    std::ostringstream oss;
-    oss << "S " << name << " " << size;
-    if (list && list->head) {
+void Stack::serializeTo(Writer& out) const {
+    out.write("S ");
+    out.write(name);
+    out.put(' ');
+    out.writeNumber(size);
+    if (list) {
         // В ForwardList head указывает на вершину стека
-        FNode* cur = list->head;
-        while (cur) {
-            oss << " " << cur->key;
-            cur = cur->next;
-        }
+        forEachFL(list, [&](std::string_view key) {
+            out.put(' ');
+            out.write(key);
+        });
     }
-    return oss.str();
 }
 
 /**
@@ -84,17 +84,15 @@ std::string Stack::serialize() const {
  * потому что pushBackFL добавляет элемент в конец, а head указывает на первый элемент,
  * который был добавлен первым (вершина стека).
  */
-void Stack::deserialize(const std::string& data) {
-    std::istringstream iss(data);
-    std::string type;
-    iss >> type; // Прочитываем тип 'S'
-    iss >> name; // Прочитываем имя стека
-    int count = 0;
-    iss >> count; // Прочитываем количество элементов
+void Stack::deserializeFrom(std::string_view data) {
+    TextReader in(data);
+    in.next(); // Прочитываем тип 'S'
+    name = std::string(in.next()); // Прочитываем имя стека
+    std::uint64_t count = in.nextNumber<std::uint64_t>(); // Прочитываем количество элементов
     if (!list) list = createFL();
     
     // Очищаем существующий список
-    while (!isEmptyFL(list)) popFrontFL(list);
+    clearFL(list);
     size = 0;
     
     // Читаем значения в порядке top->bottom, pushBackFL сохраняет правильный порядок:
@@ -102,9 +100,28 @@ void Stack::deserialize(const std::string& data) {
     // 2. pushBackFL(elem2) -> list = [elem1, elem2]
     // 3. pushBackFL(elem3) -> list = [elem1, elem2, elem3]
     // Результат: head = elem1 (вершина), tail = elem3 (дно)
-    for (int i = 0; i < count; ++i) {
-        std::string v; iss >> v;
-        pushBackFL(list, v);
+    for (std::uint64_t i = 0; i < count; ++i) {
+        pushBackFL(list, std::string(in.next()));
         size++;
     }
-}
\ No newline at end of file
+}
+
+void Stack::serializeBinary(std::string& out) const {
+    appendU64(out, size);
+    if (list) {
+        forEachFL(list, [&](std::string_view key) { appendString(out, key); });
+    }
+}
+
+void Stack::deserializeBinary(const char* data, std::size_t dataSize) {
+    BinaryReader in(data, dataSize);
+    std::uint64_t count = in.readU64();
+    if (!list) list = createFL();
+    clearFL(list);
+    size = 0;
+    // Элементы записаны от вершины ко дну, pushBackFL сохраняет этот порядок
+    for (std::uint64_t i = 0; i < count; ++i) {
+        pushBackFL(list, in.readString());
+        size++;
+    }
+}
@@ -37,15 +37,28 @@ struct Stack : public Structure {
      * @brief Сериализует стек в формат: "S name count top ... bottom"
      * 
      * Формат: первый элемент - вершина стека (top), последний - дно (bottom).
-     * @return Строка с сохраненным состоянием стека
+     * @param out Буфер записи, в который дописывается строка
      */
-    std::string serialize() const override;
+    void serializeTo(Writer& out) const override;
     
     /**
      * @brief Десериализует стек из строки формата "S name count top ... bottom"
      * @param data Строка с сохраненными данными стека
      */
-    void deserialize(const std::string& data) override;
+    void deserializeFrom(std::string_view data) override;
+
+    /**
+     * @brief Записывает стек в бинарной форме: uint64 count, затем элементы от вершины ко дну
+     * @param out Буфер для дописывания данных
+     */
+    void serializeBinary(std::string& out) const override;
+
+    /**
+     * @brief Восстанавливает стек из бинарной формы
+     * @param data Начало полезной нагрузки
+     * @param size Длина полезной нагрузки в байтах
+     */
+    void deserializeBinary(const char* data, std::size_t size) override;
 };
 
 /**
@@ -1,7 +1,10 @@
 #ifndef STRUCTURE_H
 #define STRUCTURE_H
 
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include "TextFormat.h"
 
 /**
  * @brief Базовый абстрактный класс для всех структур данных.
@@ -9,31 +12,78 @@
  * Определяет полиморфный интерфейс для сериализации и десериализации,
  * необходимый для сохранения состояния структур данных в файл.
  * Все конкретные типы данных (массив, стеки, очереди, деревья) наследуются
- * от этого класса и реализуют методы serialize() и deserialize().
+ * от этого класса и реализуют методы serializeTo() и deserializeFrom().
  */
 struct Structure {
     /** @brief Имя структуры для идентификации в базе данных реестра */
     std::string name;
+
+    /**
+     * @brief Структура изменена с момента загрузки из файла или последнего сохранения.
+     *
+     * Выставляется обработчиками мутирующих команд. Чистые структуры при
+     * сохранении не сериализуются заново: их запись копируется из старого файла.
+     * Новая структура считается измененной.
+     */
+    bool dirty = true;
     
     /**
-     * @brief Сериализует состояние структуры в строку.
+     * @brief Дописывает текстовое представление структуры в буфер записи.
      *
-     * Преобразует текущее состояние структуры данных в текстовое представление
-     * для сохранения в файл. Формат зависит от конкретной структуры.
+     * Строка записи формируется прямо в буфере Writer (см. TextFormat.h),
+     * без промежуточных строк и потоков. Формат зависит от конкретной
+     * структуры, перевод строки не дописывается.
      *
-     * @return Строковое представление структуры (например "M name count val1 val2...")
+     * @param out Буфер записи (например "M name count val1 val2...")
      */
-    virtual std::string serialize() const = 0;
+    virtual void serializeTo(Writer& out) const = 0;
     
     /**
-     * @brief Десериализует состояние структуры из строки.
+     * @brief Восстанавливает состояние структуры из строки текстового формата.
      *
-     * Восстанавливает состояние структуры данных из текстового представления,
-     * которое было загружено из файла.
+     * Строка разбирается на месте (обычно прямо в отображенном файле),
+     * числа читаются через std::from_chars.
      *
+     * @param data Строка с сохраненным состоянием структуры (тип, имя, значения)
+     * @throw std::runtime_error если количество или ключ не являются числом
+     */
+    virtual void deserializeFrom(std::string_view data) = 0;
+
+    /**
+     * @brief Сериализует состояние структуры в новую строку (обертка над serializeTo()).
+     * @return Строковое представление структуры
+     */
+    std::string serialize() const {
+        std::string line;
+        Writer out(line);
+        serializeTo(out);
+        return line;
+    }
+
+    /**
+     * @brief Десериализует состояние структуры из строки (обертка над deserializeFrom()).
      * @param data Строка с сохраненным состоянием структуры
      */
-    virtual void deserialize(const std::string& data) = 0;
+    void deserialize(const std::string& data) { deserializeFrom(data); }
+
+    /**
+     * @brief Дописывает бинарное представление содержимого структуры в буфер.
+     *
+     * Используется бинарным форматом снимка базы (см. BinaryFormat.h).
+     * Тип и имя структуры хранятся в каталоге снимка и сюда не входят.
+     *
+     * @param out Буфер, в конец которого дописываются данные
+     */
+    virtual void serializeBinary(std::string& out) const = 0;
+
+    /**
+     * @brief Восстанавливает содержимое структуры из бинарного представления.
+     *
+     * @param data Начало полезной нагрузки структуры (например, в отображенном файле)
+     * @param size Длина полезной нагрузки в байтах
+     * @throw std::runtime_error если данные обрезаны
+     */
+    virtual void deserializeBinary(const char* data, std::size_t size) = 0;
     
     /** @brief Виртуальный деструктор для корректного удаления производных классов */
     virtual ~Structure() = default;
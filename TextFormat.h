@@ -0,0 +1,128 @@
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#include <charconv>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Примитивы текстового формата базы данных.
+ *
+ * Запись структуры - одна строка "TYPE name count value1 value2 ...",
+ * значения разделены пробелами. Writer дописывает строку в переиспользуемый
+ * буфер (или сразу в поток порциями), TextReader разбирает ее на месте
+ * без копирования исходных данных; числа читаются и пишутся через
+ * std::from_chars/std::to_chars, без потоков и локалей.
+ */
+
+/**
+ * @brief Буферизованная запись текстового представления.
+ *
+ * В режиме строки данные дописываются в конец переданной строки.
+ * В режиме потока накапливаются во внутреннем буфере и сбрасываются в поток,
+ * когда буфер превышает порог, - размер памяти не зависит от размера структуры.
+ */
+struct Writer {
+    std::ostream* sink = nullptr;
+    std::string own;
+    std::string* buf;
+    std::size_t threshold = 0;
+    std::uint64_t flushed = 0;
+
+    explicit Writer(std::string& target) : buf(&target) {}
+
+    explicit Writer(std::ostream& out, std::size_t flushThreshold = 64 * 1024)
+        : sink(&out), buf(&own), threshold(flushThreshold) {
+        own.reserve(flushThreshold + 256);
+    }
+
+    ~Writer() { flush(); }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    void put(char c) {
+        buf->push_back(c);
+        flushIfFull();
+    }
+
+    void write(std::string_view s) {
+        buf->append(s.data(), s.size());
+        flushIfFull();
+    }
+
+    void write(const char* data, std::size_t size) {
+        buf->append(data, size);
+        flushIfFull();
+    }
+
+    template<typename T>
+    void writeNumber(T v) {
+        char tmp[24];
+        std::to_chars_result r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        buf->append(tmp, static_cast<std::size_t>(r.ptr - tmp));
+        flushIfFull();
+    }
+
+    /** @brief Количество байт, записанных через этот Writer (включая еще не сброшенные) */
+    std::uint64_t position() const { return flushed + buf->size(); }
+
+    /** @brief Сбрасывает накопленные данные в поток (в режиме строки ничего не делает) */
+    void flush() {
+        if (!sink || buf->empty()) return;
+        sink->write(buf->data(), static_cast<std::streamsize>(buf->size()));
+        flushed += buf->size();
+        buf->clear();
+    }
+
+private:
+    void flushIfFull() {
+        if (sink && buf->size() >= threshold) flush();
+    }
+};
+
+/**
+ * @brief Разбор строки текстового формата на слова без копирования.
+ *
+ * Слова - возвращаемые string_view - указывают в исходный буфер
+ * (обычно отображенный через mmap файл), который должен жить дольше читателя.
+ */
+struct TextReader {
+    std::string_view rest;
+
+    explicit TextReader(std::string_view data) : rest(data) {}
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    /** @brief Следующее слово или пустая строка, если слова кончились */
+    std::string_view next() {
+        std::size_t i = 0;
+        while (i < rest.size() && isSpace(rest[i])) ++i;
+        std::size_t start = i;
+        while (i < rest.size() && !isSpace(rest[i])) ++i;
+        std::string_view token = rest.substr(start, i - start);
+        rest.remove_prefix(i);
+        return token;
+    }
+
+    /**
+     * @brief Следующее слово как число.
+     * @throw std::runtime_error если слово отсутствует или не является числом типа T
+     */
+    template<typename T>
+    T nextNumber() {
+        std::string_view token = next();
+        T v{};
+        std::from_chars_result r = std::from_chars(token.data(), token.data() + token.size(), v);
+        if (token.empty() || r.ec != std::errc() || r.ptr != token.data() + token.size()) {
+            throw std::runtime_error("Malformed text record");
+        }
+        return v;
+    }
+};
+
+#endif
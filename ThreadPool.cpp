@@ -0,0 +1,102 @@
+#include "ThreadPool.h"
+#include <memory>
+
+// Поток уже выполняет задачу пула: вложенный parallelFor идет последовательно
+static thread_local bool insidePool = false;
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    for (std::size_t i = 1; i < threads; ++i) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) t.join();
+}
+
+void ThreadPool::runTasks() {
+    insidePool = true;
+    std::size_t i;
+    while ((i = nextTask.fetch_add(1)) < jobCount) {
+        try {
+            (*job)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) error = std::current_exception();
+            // Остальные задачи пропускаются
+            nextTask = jobCount;
+        }
+    }
+    insidePool = false;
+}
+
+void ThreadPool::workerLoop() {
+    std::size_t seenEpoch = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || jobEpoch != seenEpoch; });
+            if (stopping) return;
+            seenEpoch = jobEpoch;
+        }
+        runTasks();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++finishedWorkers;
+        }
+        done.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn) {
+    if (count == 0) return;
+    if (workers.empty() || count == 1 || insidePool) {
+        for (std::size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(callMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        nextTask = 0;
+        finishedWorkers = 0;
+        error = nullptr;
+        ++jobEpoch;
+    }
+    wake.notify_all();
+    runTasks();
+
+    std::exception_ptr failure;
+    {
+        // Каждый поток должен отработать задание: fn и счетчики переживают их всех
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return finishedWorkers == workers.size(); });
+        job = nullptr;
+        failure = error;
+        error = nullptr;
+    }
+    if (failure) std::rethrow_exception(failure);
+}
+
+static std::size_t requestedThreads = 0;
+
+void setThreadPoolSize(std::size_t threads) {
+    requestedThreads = threads;
+}
+
+ThreadPool& sharedThreadPool() {
+    static std::unique_ptr<ThreadPool> pool([]() {
+        std::size_t threads = requestedThreads;
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        return new ThreadPool(threads);
+    }());
+    return *pool;
+}
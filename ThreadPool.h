@@ -0,0 +1,77 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Пул потоков для параллельной сериализации и разбора структур базы.
+ *
+ * Структуры базы независимы друг от друга, поэтому их разбор и сериализация
+ * раскладываются по ядрам: parallelFor(count, fn) вызывает fn(0..count-1)
+ * на потоках пула и на вызывающем потоке и возвращается, когда все вызовы
+ * завершены. Первое исключение из fn пробрасывается вызывающему.
+ *
+ * Вложенный вызов parallelFor из fn выполняется последовательно.
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threads Общее число потоков, включая вызывающий (1 - без параллелизма)
+     */
+    explicit ThreadPool(std::size_t threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** @brief Общее число потоков, участвующих в parallelFor */
+    std::size_t size() const { return workers.size() + 1; }
+
+    /**
+     * @brief Выполняет fn(i) для всех i из [0, count).
+     * @param count Количество независимых задач
+     * @param fn Задача; вызывается конкурентно для разных i
+     */
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn);
+
+private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex callMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping = false;
+
+    // Текущее задание parallelFor
+    const std::function<void(std::size_t)>* job = nullptr;
+    std::size_t jobCount = 0;
+    std::atomic<std::size_t> nextTask{0};
+    std::size_t jobEpoch = 0;
+    std::size_t finishedWorkers = 0;
+    std::exception_ptr error;
+};
+
+/**
+ * @brief Задает число потоков общего пула (по умолчанию - число ядер).
+ *
+ * Должна вызываться до первого использования sharedThreadPool().
+ *
+ * @param threads Число потоков (0 - по числу ядер)
+ */
+void setThreadPoolSize(std::size_t threads);
+
+/**
+ * @brief Общий пул потоков процесса; создается при первом обращении.
+ */
+ThreadPool& sharedThreadPool();
+
+#endif
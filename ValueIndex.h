@@ -0,0 +1,184 @@
+#ifndef VALUE_INDEX_H
+#define VALUE_INDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Хеш-индекс значений списка: значение -> узлы всех вхождений.
+ *
+ * Включается для отдельного списка (FINDEX / LINDEX) и сохраняется вместе
+ * с ним как флаг; сами записи индекса в файл не попадают. После загрузки
+ * индекс пуст и строится при первом поиске или удалении по значению
+ * (ленивое построение), до этого мутации его не обновляют.
+ *
+ * Запись хранит узлы всех вхождений значения в порядке списка (у развернутого
+ * списка узел повторяется по разу на каждое вхождение в нем), поэтому первое
+ * вхождение для поиска и удаления по значению берется за O(1) и при повторах.
+ * Порядок узлов определяется метками order: они возрастают вдоль списка,
+ * новый узел получает метку между соседями, а когда промежуток исчерпан,
+ * метки переразмечаются в наименьшем выровненном диапазоне, который еще
+ * не переполнен (амортизированно O(log n) на вставку узла).
+ *
+ * Требования к Node: поля next, prev и std::uint64_t order.
+ *
+ * @tparam Node Тип узла списка (FNode, DFNode)
+ */
+template<typename Node>
+struct ValueIndex {
+    /** @brief Запись индекса */
+    struct Entry {
+        /** @brief Узлы вхождений в порядке списка; действуют nodes[head..] */
+        std::vector<Node*> nodes;
+        /** @brief Свободное место перед первым вхождением (удаленные и запас для вставки в начало) */
+        std::size_t head = 0;
+
+        /** @brief Число вхождений значения */
+        std::size_t count() const { return nodes.size() - head; }
+        /** @brief Узел первого по порядку вхождения */
+        Node* first() const { return nodes[head]; }
+    };
+
+    /** @brief Шаг меток при разметке всего списка и дописывании в его концы */
+    static constexpr std::uint64_t ORDER_STEP = std::uint64_t(1) << 32;
+
+    /** @brief Индекс включен для списка */
+    bool enabled = false;
+    /** @brief Записи соответствуют содержимому списка */
+    bool built = false;
+    /** @brief Значение -> запись */
+    std::unordered_map<std::string, Entry> entries;
+
+    /** @brief Размечает весь список с шагом ORDER_STEP (при построении индекса) */
+    void label(Node* first) {
+        std::size_t n = 0;
+        for (Node* node = first; node; node = node->next) ++n;
+        std::uint64_t gap = std::min<std::uint64_t>(ORDER_STEP, UINT64_MAX / (n + 1));
+        std::uint64_t order = 0;
+        for (Node* node = first; node; node = node->next) node->order = order += gap;
+    }
+
+    /** @brief Узел node связан с соседями по списку: он получает метку между ними */
+    void linked(Node* node) {
+        if (!built) return;
+        std::uint64_t lo = node->prev ? node->prev->order : 0;
+        std::uint64_t hi = node->next ? node->next->order : UINT64_MAX;
+        if (!node->next && hi - lo > ORDER_STEP) node->order = lo + ORDER_STEP;
+        else if (!node->prev && hi > ORDER_STEP) node->order = hi - ORDER_STEP;
+        else if (hi - lo > 1) node->order = lo + (hi - lo) / 2;
+        else relabel(node);
+    }
+
+    /** @brief Добавлено вхождение value в узле node (узел уже связан) */
+    void add(const std::string& value, Node* node) {
+        if (!built) return;
+        Entry& e = entries[value];
+        std::vector<Node*>& v = e.nodes;
+        // Вхождения перед первым и после последнего добавляются без сдвига записей
+        if (v.empty() || v.back()->order <= node->order) {
+            v.push_back(node);
+        } else if (node->order <= v[e.head]->order) {
+            if (e.head == 0) {
+                // Место в начале удваивается, как емкость vector в конце
+                e.head = v.size();
+                v.insert(v.begin(), e.head, nullptr);
+            }
+            v[--e.head] = node;
+        } else {
+            v.insert(std::upper_bound(v.begin() + e.head, v.end(), node, byOrder), node);
+        }
+    }
+
+    /** @brief Удалено одно вхождение value из узла node */
+    void remove(const std::string& value, Node* node) {
+        if (!built) return;
+        auto it = entries.find(value);
+        if (it == entries.end()) return;
+        Entry& e = it->second;
+        if (e.count() == 1) {
+            entries.erase(it);
+            return;
+        }
+        std::vector<Node*>& v = e.nodes;
+        if (v[e.head] == node) {
+            // Место в начале освобождается, когда его вдвое больше, чем вхождений
+            if (++e.head > 2 * e.count()) {
+                v.erase(v.begin(), v.begin() + e.head);
+                e.head = 0;
+            }
+            return;
+        }
+        v.erase(std::upper_bound(v.begin() + e.head, v.end(), node, byOrder) - 1);
+    }
+
+    /**
+     * @brief Вхождение value перенесено из узла from в соседний узел to
+     * (деление или слияние узлов развернутого списка, оба узла связаны)
+     */
+    void moved(const std::string& value, Node* from, Node* to) {
+        if (!built) return;
+        auto it = entries.find(value);
+        if (it == entries.end()) return;
+        std::vector<Node*>& v = it->second.nodes;
+        auto begin = v.begin() + it->second.head;
+        // В to переходят крайние вхождения from со стороны to: порядок записей сохраняется
+        if (from->order < to->order) *(std::upper_bound(begin, v.end(), from, byOrder) - 1) = to;
+        else *std::lower_bound(begin, v.end(), from, byOrder) = to;
+    }
+
+    /** @brief Запись значения или nullptr, если значения нет (индекс построен) */
+    Entry* find(const std::string& value) {
+        auto it = entries.find(value);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+
+    /** @brief Сбрасывает записи; индекс будет построен заново при первом запросе */
+    void invalidate() {
+        std::unordered_map<std::string, Entry>().swap(entries);
+        built = false;
+    }
+
+private:
+    static bool byOrder(const Node* a, const Node* b) { return a->order < b->order; }
+
+    /**
+     * Переразметка вокруг node, когда между соседями нет свободной метки:
+     * выровненный диапазон меток размером 2^bits растет, пока узлов в нем
+     * не станет меньше (4/3)^bits, затем его узлы размечаются равномерно.
+     */
+    void relabel(Node* node) {
+        std::uint64_t anchor = node->prev ? node->prev->order : 0;
+        Node* left = node;
+        Node* right = node;
+        std::size_t count = 1;
+        double capacity = 1.0;
+        for (int bits = 1; bits < 64; ++bits) {
+            capacity *= 4.0 / 3.0;
+            std::uint64_t size = std::uint64_t(1) << bits;
+            std::uint64_t base = anchor & ~(size - 1);
+            while (left->prev && left->prev->order >= base) { left = left->prev; ++count; }
+            while (right->next && right->next->order - base < size) { right = right->next; ++count; }
+            if (static_cast<double>(count) < capacity) {
+                spread(left, right, base, size / (count + 1));
+                return;
+            }
+        }
+        // Переполнено все пространство меток: размечается весь список
+        while (left->prev) { left = left->prev; ++count; }
+        while (right->next) { right = right->next; ++count; }
+        spread(left, right, 0, UINT64_MAX / (count + 1));
+    }
+
+    static void spread(Node* left, Node* right, std::uint64_t base, std::uint64_t gap) {
+        for (Node* n = left;; n = n->next) {
+            n->order = base += gap;
+            if (n == right) break;
+        }
+    }
+};
+
+#endif
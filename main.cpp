@@ -1,35 +1,133 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <fstream>
 #include <vector>
 #include <functional>
 #include <cstdlib>
+#include <cctype>
+#include <cerrno>
 #include "Array.h"
 #include "ForwardList.h"
 #include "DoubleList.h"
 #include "Stack.h"
 #include "Queue.h"
 #include "FullBinaryTree.h"
+#include "BPlusTree.h"
 #include "FileIO.h"
 #include "Print.h"
 #include "Factory.h"
+#include "Server.h"
+#include "MutationLog.h"
+#include "ThreadPool.h"
+#include "ListPack.h"
 #include <map>
+#include <set>
+#include <algorithm>
 
 using namespace std;
 
+/**
+ * @brief Ошибка выполнения команды.
+ *
+ * Сообщение имеет вид "ERROR <код>: <описание>". В однократном режиме (--query)
+ * оно печатается в stderr и процесс завершается с кодом 1; в режиме сервера
+ * ошибка возвращается клиенту, а процесс продолжает работу.
+ */
+struct QueryError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] void fail(const std::string& message) {
+    throw QueryError(message);
+}
+
 int safeStoi(const string& str) {
     try {
         return stoi(str);
     } catch (...) {
-        cerr << "ERROR 30: Invalid index/argument" << endl;
-        exit(1);
+        fail("ERROR 30: Invalid index/argument");
+    }
+}
+
+std::int64_t safeStoll(const string& str) {
+    try {
+        return static_cast<std::int64_t>(stoll(str));
+    } catch (...) {
+        fail("ERROR 30: Invalid index/argument");
+    }
+}
+
+/** Ключ дерева из аргумента команды: число для BTree/BTree64, слово как есть для StringBTree */
+template<typename Key>
+Key parseTreeKey(const string& token);
+
+template<>
+int parseTreeKey<int>(const string& token) { return safeStoi(token); }
+
+template<>
+std::int64_t parseTreeKey<std::int64_t>(const string& token) { return safeStoll(token); }
+
+template<>
+std::string parseTreeKey<std::string>(const string& token) { return token; }
+
+/**
+ * Можно ли читать ключи "@-" из стандартного ввода: нельзя, если из него
+ * читаются сами команды (--stdin) или процесс работает сервером (--serve).
+ */
+static bool stdinKeysAllowed = true;
+
+/**
+ * Ключи пакетной команды (TMSEARCH): аргументы начиная с paramStart либо один
+ * аргумент "@путь" - ключи через пробельные символы из файла ("@-" - из
+ * стандартного ввода до его конца, см. stdinKeysAllowed).
+ */
+std::vector<string> multiKeyTokens(const std::vector<string>& tokens, std::size_t paramStart) {
+    if (tokens.size() == paramStart + 1 && tokens[paramStart].size() > 1 && tokens[paramStart][0] == '@') {
+        const string path = tokens[paramStart].substr(1);
+        std::ifstream file;
+        if (path == "-" && !stdinKeysAllowed) fail("ERROR 30: Invalid index/argument");
+        if (path != "-") {
+            file.open(path);
+            if (!file.is_open()) fail("ERROR 30: Invalid index/argument");
+        }
+        std::istream& in = path == "-" ? std::cin : file;
+        std::vector<string> keys;
+        string key;
+        while (in >> key) keys.push_back(key);
+        if (keys.empty()) fail("ERROR 30: Invalid index/argument");
+        return keys;
     }
+    if (tokens.size() <= paramStart) fail("ERROR 30: Invalid index/argument");
+    return std::vector<string>(tokens.begin() + paramStart, tokens.end());
 }
 
+class StructureManager;
+void processQuery(const std::string& query, StructureManager& manager);
+bool isMutatingCommand(const std::string& cmd);
+
 class StructureManager {
 private:
     std::string currentFilename;
+    // Загруженные структуры; index описывает все структуры файла, в том числе
+    // загруженные и не измененные (их записи копируются при сохранении)
     std::map<std::string, Structure*> database;
+    DatabaseIndex index;
+    // Формат сохранения: по умолчанию совпадает с форматом загруженного файла
+    DatabaseFormat format = DatabaseFormat::Text;
+    bool formatForced = false;
+    // Журнал мутаций (--log): поколение загруженного снимка и порог уплотнения
+    MutationLog log;
+    bool logEnabled = false;
+    bool replaying = false;
+    std::uint64_t generation = 0;
+    std::uint64_t compactThreshold = 16 * 1024 * 1024;
+    // Политика fsync для снимков и журнала (--fsync)
+    FsyncPolicy fsyncPolicy;
+    // Структура, автоматически созданная текущей командой (пусто - не создавалась),
+    // и структура другого типа, которую она заменила под тем же именем
+    std::string autoCreated;
+    Structure* replaced = nullptr;
 
 public:
     ~StructureManager() { cleanup(); }
@@ -37,39 +135,264 @@ public:
     void setFilename(const std::string& filename) { currentFilename = filename; }
     std::string getFilename() const { return currentFilename; }
 
+    void setFormat(DatabaseFormat f) { format = f; formatForced = true; }
+
+    void enableMutationLog(std::uint64_t threshold) { logEnabled = true; compactThreshold = threshold; }
+    void setFsyncPolicy(const FsyncPolicy& policy) { fsyncPolicy = policy; log.fsync = policy; }
+    bool isMutationLogEnabled() const { return logEnabled; }
+
+    std::size_t structureCount() const {
+        std::size_t count = index.entries.size();
+        for (const auto& kv : database) {
+            if (!index.entries.count(kv.first)) ++count;
+        }
+        return count;
+    }
+
+    /**
+     * Есть ли изменения, которых нет в файле: измененные или новые структуры,
+     * смена формата (--format) или еще не созданный файл.
+     */
+    bool isDirty() const {
+        for (const auto& kv : database) {
+            if (kv.second->dirty) return true;
+        }
+        if (!fileExists(currentFilename)) return true;
+        return formatForced && format != index.format;
+    }
+
     void cleanup() {
         for (auto &kv : database) delete kv.second;
         database.clear();
+        index = DatabaseIndex();
     }
 
+    /**
+     * Перезапись базы. Заново сериализуются только измененные структуры,
+     * остальные копируются из старого файла побайтно; если изменений нет,
+     * файл не трогается. Если рядом есть журнал мутаций, снимок получает
+     * следующее поколение, а журнал удаляется: его команды уже вошли в снимок.
+     */
     void saveCurrentStructure() {
         if (currentFilename.empty()) return;
-        try { saveDatabaseToFile(currentFilename, database); }
-        catch (...) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+        try {
+            bool foldLog = logEnabled || fileExists(mutationLogPath(currentFilename));
+            if (!foldLog && !isDirty()) return;
+            if (foldLog) finishCompaction(log, true);
+            std::uint64_t snapshotGeneration = foldLog ? generation + 1 : generation;
+
+            // Снимок пишется во временный файл и заменяет базу атомарно: старый файл
+            // остается отображенным в память, пока из него копируются структуры
+            saveDatabaseAtomically(currentFilename, database, format, snapshotGeneration, &index,
+                                   fsyncPolicy.mode != FsyncPolicy::NEVER);
+            generation = snapshotGeneration;
+
+            // Теперь файл совпадает с памятью: следующее сохранение копирует из него
+            loadDatabaseIndex(currentFilename, index);
+            for (auto& kv : database) kv.second->dirty = false;
+
+            if (foldLog) {
+                removeMutationLog(log, currentFilename);
+                if (logEnabled) openMutationLog(log, currentFilename, generation);
+            }
+        }
+        catch (const QueryError&) { throw; }
+        catch (...) { fail("ERROR 30: Invalid index/argument"); }
+    }
+
+    /**
+     * Фиксирует изменения после выполнения команд. Без журнала - перезапись
+     * базы; с журналом команды уже дописаны, остается сбросить их на диск
+     * одним fsync на всю пачку (групповая фиксация) и завершить идущее
+     * уплотнение. wait=false - не блокироваться на уплотнении и соблюдать
+     * интервал fsync; wait=true (завершение процесса) - сбросить журнал сразу.
+     */
+    void commit(bool wait = true) {
+        if (!logEnabled) { saveCurrentStructure(); return; }
+        try {
+            if (finishCompaction(log, wait) && log.file) generation = log.generation;
+            syncMutationLog(log, wait);
+        }
+        catch (...) { fail("ERROR 30: Invalid index/argument"); }
     }
 
     bool loadStructuresFromFile(const std::string& filename) {
-        try { cleanup(); loadDatabaseFromFile(filename, database); currentFilename = filename; return true; }
-        catch (...) { cerr << "ERROR 10: Unknown command" << endl; exit(1); return false; }
+        try {
+            // Читается только оглавление: структуры загружаются при первом обращении
+            cleanup();
+            loadDatabaseIndex(filename, index);
+            if (!formatForced) format = index.format;
+            currentFilename = filename;
+            generation = index.generation;
+        }
+        catch (...) { fail("ERROR 10: Unknown command"); }
+
+        // Проигрываем журнал мутаций поверх снимка; вывод команд не нужен.
+        // В журнал попадают только успешные команды, поэтому ошибка при
+        // проигрывании значит, что база разошлась с журналом: загрузка прерывается
+        std::vector<std::string> commands = readMutationLog(filename, generation);
+        if (!commands.empty()) {
+            prefetch(commands);
+            std::streambuf* saved = cout.rdbuf(nullptr);
+            replaying = true;
+            std::size_t failed = commands.size();
+            std::string error;
+            for (std::size_t i = 0; i < commands.size() && failed == commands.size(); ++i) {
+                try { processQuery(commands[i], *this); }
+                catch (const QueryError& e) { failed = i; error = e.what(); }
+                catch (...) { failed = i; error = "ERROR 10: Unknown command"; }
+            }
+            replaying = false;
+            cout.rdbuf(saved);
+            cout.clear();
+            if (failed != commands.size()) {
+                cerr << mutationLogPath(filename) << ": command " << failed + 1
+                     << " (" << commands[failed] << ") failed on replay" << endl;
+                fail(error);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Записывает успешно выполненную мутирующую команду в журнал и при
+     * превышении порога запускает фоновое уплотнение.
+     */
+    void recordMutation(const std::string& query) {
+        if (!logEnabled || replaying || currentFilename.empty()) return;
+        try {
+            if (!log.file) openMutationLog(log, currentFilename, generation);
+            appendMutation(log, query);
+            if (log.compacting) {
+                if (finishCompaction(log, false)) generation = log.generation;
+            } else if (log.bytes >= compactThreshold) {
+                std::ostringstream snapshot;
+                writeDatabase(snapshot, database, format, log.generation + 1, &index);
+                beginCompaction(log, snapshot.str());
+            }
+        }
+        catch (...) { fail("ERROR 30: Invalid index/argument"); }
+    }
+
+    /**
+     * Возвращает структуру по имени, при необходимости загружая ее из файла
+     * по оглавлению. Остальные структуры файла не разбираются.
+     */
+    Structure* find(const std::string& name) {
+        auto it = database.find(name);
+        if (it != database.end()) return it->second;
+        if (!index.entries.count(name)) return nullptr;
+
+        Structure* obj = nullptr;
+        try {
+            obj = loadIndexedStructure(index, name);
+        } catch (...) {
+            // Оглавление не совпало с файлом: строим его заново проходом по строкам
+            try {
+                loadDatabaseIndex(currentFilename, index, false);
+                obj = loadIndexedStructure(index, name);
+            } catch (...) { fail("ERROR 10: Unknown command"); }
+        }
+        if (!obj) return nullptr;
+        obj->dirty = false;
+        database[name] = obj;
+        return obj;
+    }
+
+    bool exists(const std::string& name) const {
+        return database.count(name) > 0 || index.entries.count(name) > 0;
+    }
+
+    /**
+     * Заранее загружает еще не загруженные структуры, которые называют
+     * команды пакета (имя - второй токен, иначе "default"): их записи
+     * разбираются параллельно на общем пуле потоков. Запись, которую не
+     * удалось разобрать, остается find(): он перестроит оглавление.
+     */
+    void prefetch(const std::vector<std::string>& commands) {
+        std::set<std::string> wanted;
+        for (const std::string& command : commands) {
+            std::istringstream iss(command);
+            std::string cmd, name;
+            iss >> cmd >> name;
+            if (!exists(name)) name = "default";
+            if (!database.count(name) && index.entries.count(name)) wanted.insert(name);
+        }
+        if (wanted.size() < 2) return;
+
+        std::vector<const std::string*> names;
+        for (const std::string& name : wanted) names.push_back(&name);
+        std::vector<Structure*> loaded(names.size(), nullptr);
+        sharedThreadPool().parallelFor(names.size(), [&](std::size_t i) {
+            try { loaded[i] = loadIndexedStructure(index, *names[i]); } catch (...) {}
+        });
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            if (!loaded[i]) continue;
+            loaded[i]->dirty = false;
+            database[*names[i]] = loaded[i];
+        }
+    }
+
+    /** Добавляет структуру, созданную командой при первом обращении к имени */
+    void autoCreate(const std::string& name, Structure* s) {
+        s->name = name;
+        Structure*& slot = database[name];
+        replaced = slot;
+        slot = s;
+        autoCreated = name;
+    }
+
+    /** Начало команды: автоматически созданной структуры еще нет */
+    void beginCommand() {
+        autoCreated.clear();
+        replaced = nullptr;
+    }
+
+    /** Команда выполнена: замененная структура больше не нужна */
+    void keepAutoCreated() {
+        delete replaced;
+        replaced = nullptr;
+        autoCreated.clear();
+    }
+
+    /**
+     * Команда завершилась ошибкой: автоматически созданная ею структура
+     * удаляется, как если бы команда не выполнялась (она не попадает ни в
+     * файл, ни в журнал мутаций), а замененная возвращается на место.
+     */
+    void discardAutoCreated() {
+        if (autoCreated.empty()) return;
+        auto it = database.find(autoCreated);
+        delete it->second;
+        if (replaced) it->second = replaced;
+        else database.erase(it);
+        replaced = nullptr;
+        autoCreated.clear();
+    }
+
+    /** Отмечает структуру измененной, если команда мутирующая */
+    void touch(Structure* s, const std::string& cmd) {
+        if (isMutatingCommand(cmd)) s->dirty = true;
     }
 
     template<typename T>
     T* get(const std::string& name) {
-        auto it = database.find(name);
-        if (it == database.end()) return nullptr;
-        return dynamic_cast<T*>(it->second);
+        return dynamic_cast<T*>(find(name));
     }
 
     void printCurrentStructure(const std::string& name) {
-        if (!database.count(name)) { cerr<<"ERROR 20: Structure not found"<<endl; exit(1); }
-        Structure* s = database[name];
+        Structure* s = find(name);
+        if (!s) { fail("ERROR 20: Structure not found"); }
         if (Array* a = dynamic_cast<Array*>(s)) { PRINT(*a); return; }
         if (ForwardList* fl = dynamic_cast<ForwardList*>(s)) { PRINT(*fl); return; }
         if (DFList* dl = dynamic_cast<DFList*>(s)) { PRINT(*dl); return; }
         if (Stack* st = dynamic_cast<Stack*>(s)) { PRINT(*st); return; }
         if (Queue* q = dynamic_cast<Queue*>(s)) { PRINT(*q); return; }
         if (BTree* t = dynamic_cast<BTree*>(s)) { PRINT(*t); return; }
-        cerr<<"ERROR 10: Unknown command"<<endl; exit(1);
+        if (BTree64* t = dynamic_cast<BTree64*>(s)) { PRINT(*t); return; }
+        if (StringBTree* t = dynamic_cast<StringBTree*>(s)) { PRINT(*t); return; }
+        if (BPlusTree* b = dynamic_cast<BPlusTree*>(s)) { PRINT(*b); return; }
+        fail("ERROR 10: Unknown command");
     }
 
     /**
@@ -95,7 +418,7 @@ public:
                 if (tokens.size() > 1) {
                     name = tokens[1];
                 }
-                if (database.count(name)) { cerr << "ERROR 21: Structure already exists" << endl; exit(1); }
+                if (exists(name)) { fail("ERROR 21: Structure already exists"); }
                 Array* arr = new Array(); createArray(arr, 10); arr->name = name; database[name] = arr; return;
             }
 
@@ -104,36 +427,55 @@ public:
             // так и структуры по умолчанию "MPUSH 10"
             std::string name = "default";
             int paramStart = 1;
-            if (tokens.size() > 1 && database.count(tokens[1]) > 0) {
+            if (tokens.size() > 1 && exists(tokens[1])) {
                 name = tokens[1];
                 paramStart = 2;
             }
 
             Array* arr = get<Array>(name);
-            if (!arr) { cerr << "ERROR 20: Structure not found" << endl; exit(1); }
+            if (!arr) { fail("ERROR 20: Structure not found"); }
+            touch(arr, tokens[0]);
 
             // Обработка операций над массивом
             if (tokens[0] == "MPUSH") {
                 // MPUSH value - добавляет элемент в конец массива
-                if (tokens.size() <= paramStart) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() <= paramStart) { fail("ERROR 30: Invalid index/argument"); }
                 addElementEndArray(arr, tokens[paramStart]);
             } else if (tokens[0] == "MPUSHAT") {
                 // MPUSHAT value index - вставляет элемент в указанную позицию
-                if (tokens.size() <= paramStart + 1) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() <= paramStart + 1) { fail("ERROR 30: Invalid index/argument"); }
                 std::size_t idx = static_cast<std::size_t>(safeStoi(tokens[paramStart + 1])); addElementIndexArray(arr, tokens[paramStart], idx);
             } else if (tokens[0] == "MGET") {
-                if (tokens.size() <= paramStart) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() <= paramStart) { fail("ERROR 30: Invalid index/argument"); }
                 std::size_t idx = static_cast<std::size_t>(safeStoi(tokens[paramStart])); cout << getElementArray(arr, idx) << endl;
             } else if (tokens[0] == "MDEL") {
-                if (tokens.size() <= paramStart) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() <= paramStart) { fail("ERROR 30: Invalid index/argument"); }
                 std::size_t idx = static_cast<std::size_t>(safeStoi(tokens[paramStart])); deleteElementArray(arr, idx);
             } else if (tokens[0] == "MSET") {
-                if (tokens.size() <= paramStart + 1) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() <= paramStart + 1) { fail("ERROR 30: Invalid index/argument"); }
                 std::size_t idx = static_cast<std::size_t>(safeStoi(tokens[paramStart])); setKeyArray(arr, tokens[paramStart + 1], idx);
             } else if (tokens[0] == "MLEN") {
                 cout << getArrayLength(arr) << endl;
-            } else { cerr << "ERROR 10: Unknown command" << endl; exit(1); }
-        } catch (...) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+            } else { fail("ERROR 10: Unknown command"); }
+        } catch (const QueryError&) { throw; }
+        catch (...) { fail("ERROR 30: Invalid index/argument"); }
+    }
+
+    /** Режим FINDEX/LINDEX: без аргумента или ON - включить индекс значений, OFF - выключить */
+    static bool parseIndexSwitch(const std::vector<std::string>& tokens, std::size_t paramStart) {
+        if (tokens.size() <= paramStart || tokens[paramStart] == "ON") return true;
+        if (tokens[paramStart] == "OFF") return false;
+        fail("ERROR 30: Invalid index/argument");
+    }
+
+    /** Память списка (FMEM, LMEM, SMEM, QMEM): буфер компактного представления или пул узлов */
+    static void printListMemory(bool packed, const ListPack& pack, const NodePoolStats& s) {
+        if (packed) {
+            cout << "listpack entries=" << pack.size() << " bytes=" << pack.bytes() << endl;
+            return;
+        }
+        cout << "slabs=" << s.slabs << " capacity=" << s.capacity << " live=" << s.live
+             << " free=" << s.free << " bytes=" << s.bytes << endl;
     }
 
     void handleFCommand(const std::vector<std::string>& tokens) {
@@ -144,14 +486,14 @@ public:
                 if (tokens.size() > 1) {
                     name = tokens[1];
                 }
-                if (database.count(name)) { cerr << "ERROR 21: Structure already exists" << endl; exit(1); }
+                if (exists(name)) { fail("ERROR 21: Structure already exists"); }
                 ForwardList* fl = createFL(); fl->name = name; database[name] = fl; return;
             }
 
             // Для других команд: определяем имя структуры и начальный индекс параметров
             std::string name = "default";
             int paramStart = 1;
-            if (tokens.size() > 1 && database.count(tokens[1]) > 0) {
+            if (tokens.size() > 1 && exists(tokens[1])) {
                 name = tokens[1];
                 paramStart = 2;
             }
@@ -159,39 +501,45 @@ public:
             // Auto-create if doesn't exist
             ForwardList* fl = get<ForwardList>(name);
             if (!fl && tokens[0] != "FCREATE") {
-                fl = createFL(); fl->name = name; database[name] = fl;
+                fl = createFL(); autoCreate(name, fl);
             }
-            if (!fl) { cerr << "ERROR 20: Structure not found" << endl; exit(1); }
+            if (!fl) { fail("ERROR 20: Structure not found"); }
+            touch(fl, tokens[0]);
 
             if (tokens[0] == "FPUSH") {
-                if (tokens.size() < paramStart + 2) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() < paramStart + 2) { fail("ERROR 30: Invalid index/argument"); }
                 std::string value = tokens[paramStart]; int mode = safeStoi(tokens[paramStart + 1]);
                 if (mode == 0) pushFrontFL(fl, value);
                 else if (mode == 1) pushBackFL(fl, value);
-                else if (mode == 2) { if (fl->head) insertAfterFL(fl, value, 0); else pushFrontFL(fl, value); }
-                else if (mode == 3) { if (fl->head) { int len = 0; FNode* cur = fl->head; while (cur) { len++; cur = cur->next; } if (len>0) insertBeforeFL(fl, value, len-1); else pushFrontFL(fl, value); } else pushFrontFL(fl, value); }
-                else { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                else if (mode == 2) { if (fl->size > 0) insertAfterFL(fl, value, 0); else pushFrontFL(fl, value); }
+                else if (mode == 3) { if (fl->size > 0) insertBeforeFL(fl, value, static_cast<int>(fl->size) - 1); else pushFrontFL(fl, value); }
+                else { fail("ERROR 30: Invalid index/argument"); }
             } else if (tokens[0] == "FDEL") {
-                if (tokens.size() < paramStart + 1) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() < paramStart + 1) { fail("ERROR 30: Invalid index/argument"); }
                 int mode = safeStoi(tokens[paramStart]);
                 if (mode == 0) popFrontFL(fl);
                 else if (mode == 1) popBackFL(fl);
-                else if (mode == 2) { if (fl->head && fl->head->next) removeAfterFL(fl, fl->head); }
-                else if (mode == 3) { if (fl->head && fl->head->next) { if (fl->head->next->next==nullptr) { delete fl->head->next; fl->head->next=nullptr; fl->tail=fl->head;} else { FNode* cur=fl->head; while(cur->next->next->next) cur=cur->next; delete cur->next->next; cur->next->next=nullptr; fl->tail=cur->next;} } }
-                else { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                else if (mode == 2) { if (fl->size >= 2) removeAtFL(fl, 1); }
+                else if (mode == 3) { if (fl->size >= 2) popBackFL(fl); }
+                else { fail("ERROR 30: Invalid index/argument"); }
             } else if (tokens[0] == "FDELVAL") {
-                if (tokens.size() < paramStart + 1) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
-                std::string value = tokens[paramStart]; if (!removeByValueFL(fl, value)) { cerr << "ERROR 20: Structure not found" << endl; exit(1); }
+                if (tokens.size() < paramStart + 1) { fail("ERROR 30: Invalid index/argument"); }
+                std::string value = tokens[paramStart]; if (!removeByValueFL(fl, value)) { fail("ERROR 20: Structure not found"); }
             } else if (tokens[0] == "FSEARCH") {
-                if (tokens.size() < paramStart + 1) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
-                std::string value = tokens[paramStart]; FNode* res = findByValueFL(fl, value); cout << (res ? "TRUE" : "FALSE") << endl;
+                if (tokens.size() < paramStart + 1) { fail("ERROR 30: Invalid index/argument"); }
+                std::string value = tokens[paramStart]; cout << (containsFL(fl, value) ? "TRUE" : "FALSE") << endl;
             } else if (tokens[0] == "FGET") {
-                if (tokens.size() < paramStart + 1) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() < paramStart + 1) { fail("ERROR 30: Invalid index/argument"); }
                 int idx = safeStoi(tokens[paramStart]); cout << getAtFL(fl, idx) << endl;
             } else if (tokens[0] == "FLEN") {
-                int len = 0; FNode* cur = fl->head; while (cur) { len++; cur = cur->next; } cout << len << endl;
-            } else { cerr << "ERROR 10: Unknown command" << endl; exit(1); }
-        } catch (...) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                cout << fl->size << endl;
+            } else if (tokens[0] == "FINDEX") {
+                setIndexFL(fl, parseIndexSwitch(tokens, paramStart));
+            } else if (tokens[0] == "FMEM") {
+                printListMemory(fl->packed, fl->pack, fl->nodes.stats());
+            } else { fail("ERROR 10: Unknown command"); }
+        } catch (const QueryError&) { throw; }
+        catch (...) { fail("ERROR 30: Invalid index/argument"); }
     }
 
     void handleLCommand(const std::vector<std::string>& tokens) {
@@ -202,14 +550,14 @@ public:
                 if (tokens.size() > 1) {
                     name = tokens[1];
                 }
-                if (database.count(name)) { cerr << "ERROR 21: Structure already exists" << endl; exit(1); }
+                if (exists(name)) { fail("ERROR 21: Structure already exists"); }
                 DFList* dl = createDFList(); dl->name = name; database[name]=dl; return;
             }
             
             // Для других команд: определяем имя структуры и начальный индекс параметров
             std::string name = "default";
             int paramStart = 1;
-            if (tokens.size() > 1 && database.count(tokens[1]) > 0) {
+            if (tokens.size() > 1 && exists(tokens[1])) {
                 name = tokens[1];
                 paramStart = 2;
             }
@@ -217,40 +565,45 @@ public:
             // Auto-create if doesn't exist
             DFList* dl = get<DFList>(name);
             if (!dl && tokens[0] != "LCREATE") {
-                dl = createDFList(); dl->name = name; database[name]=dl;
+                dl = createDFList(); autoCreate(name, dl);
             }
-            if (!dl) { cerr << "ERROR 20: Structure not found" << endl; exit(1); }
+            if (!dl) { fail("ERROR 20: Structure not found"); }
+            touch(dl, tokens[0]);
             
             if (tokens[0] == "LPUSH") {
-                if (tokens.size() < paramStart + 2) { cerr << "ERROR 30: Invalid index/argument" << endl; exit(1); }
+                if (tokens.size() < paramStart + 2) { fail("ERROR 30: Invalid index/argument"); }
                 std::string value = tokens[paramStart]; int mode = safeStoi(tokens[paramStart + 1]);
                 if (mode==0) addNodeHeadDFList(dl,value);
                 else if (mode==1) addNodeTailDFList(dl,value);
-                else if (mode==2) { if (dl->head) addNodeAfterDFList(dl,value,0); else addNodeHeadDFList(dl,value); }
-                else if (mode==3) { if (dl->head) { int len=0; DFNode* cur=dl->head; while(cur){len++;cur=cur->next;} if(len>0) addNodeBeforeDFList(dl,value,len-1); else addNodeHeadDFList(dl,value);} else addNodeHeadDFList(dl,value); }
-                else { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
+                else if (mode==2) { if (dl->length > 0) addNodeAfterDFList(dl,value,0); else addNodeHeadDFList(dl,value); }
+                else if (mode==3) { if (dl->length > 0) addNodeBeforeDFList(dl,value,static_cast<int>(dl->length)-1); else addNodeHeadDFList(dl,value); }
+                else { fail("ERROR 30: Invalid index/argument"); }
             } else if (tokens[0] == "LDEL") {
-                if (tokens.size() < paramStart + 1) { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
+                if (tokens.size() < paramStart + 1) { fail("ERROR 30: Invalid index/argument"); }
                 int mode = safeStoi(tokens[paramStart]);
                 if (mode==0) deleteNodeHeadDFList(dl);
                 else if (mode==1) deleteNodeTailDFList(dl);
-                else if (mode==2) { if (dl->head && dl->head->next) { DFNode* temp=dl->head->next; dl->head->next=temp->next; if(temp->next) temp->next->prev=dl->head; else dl->tail=dl->head; delete temp; dl->length--; } }
-                else if (mode==3) { if (dl->tail && dl->tail->prev) { DFNode* temp=dl->tail->prev; dl->tail->prev=temp->prev; if(temp->prev) temp->prev->next=dl->tail; else dl->head=dl->tail; delete temp; dl->length--; } }
-                else { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
+                else if (mode==2) { if (dl->length >= 2) deleteNodeAtDFList(dl, 1); }
+                else if (mode==3) { if (dl->length >= 2) deleteNodeAtDFList(dl, static_cast<int>(dl->length) - 2); }
+                else { fail("ERROR 30: Invalid index/argument"); }
             } else if (tokens[0] == "LGET") {
-                if (tokens.size()<paramStart+1) { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
+                if (tokens.size()<paramStart+1) { fail("ERROR 30: Invalid index/argument"); }
                 int idx=safeStoi(tokens[paramStart]); cout<<getElementDFList(dl, idx)<<endl;
             } else if (tokens[0] == "LSEARCH") {
-                if (tokens.size()<paramStart+1) { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
-                DFNode* found = findNodeByValueDFList(dl, tokens[paramStart]);
-                cout << (found ? "TRUE" : "FALSE") << endl;
+                if (tokens.size()<paramStart+1) { fail("ERROR 30: Invalid index/argument"); }
+                cout << (containsDFList(dl, tokens[paramStart]) ? "TRUE" : "FALSE") << endl;
             } else if (tokens[0] == "LDELVAL") {
-                if (tokens.size()<paramStart+1) { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
+                if (tokens.size()<paramStart+1) { fail("ERROR 30: Invalid index/argument"); }
                 deleteNodeByValueDFList(dl, tokens[paramStart]);
             } else if (tokens[0] == "LLEN") {
                 cout << dl->length << endl;
-            } else { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); }
-        } catch(...) { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
+            } else if (tokens[0] == "LINDEX") {
+                setIndexDFList(dl, parseIndexSwitch(tokens, paramStart));
+            } else if (tokens[0] == "LMEM") {
+                printListMemory(dl->packed, dl->pack, dl->nodes.stats());
+            } else { fail("ERROR 10: Unknown command"); }
+        } catch (const QueryError&) { throw; }
+        catch (...) { fail("ERROR 30: Invalid index/argument"); }
     }
 
     void handleSCommand(const std::vector<std::string>& tokens) {
@@ -261,27 +614,30 @@ public:
                 if (tokens.size() > 1) {
                     name = tokens[1];
                 }
-                if(database.count(name)){ cerr<<"ERROR 21: Structure already exists"<<endl; exit(1);} Stack* s=new Stack(); s->name=name; database[name]=s; return;
+                if(exists(name)){ fail("ERROR 21: Structure already exists");} Stack* s=new Stack(); s->name=name; database[name]=s; return;
             }
             
             // Для других команд: определяем имя структуры и начальный индекс параметров
             std::string name="default";
             int paramStart = 1;
-            if (tokens.size() > 1 && database.count(tokens[1]) > 0) {
+            if (tokens.size() > 1 && exists(tokens[1])) {
                 name = tokens[1];
                 paramStart = 2;
             }
             // Auto-create if doesn't exist
             Stack* s=get<Stack>(name);
             if (!s && tokens[0] != "SCREATE") {
-                s = new Stack(); s->name=name; database[name]=s;
+                s = new Stack(); autoCreate(name, s);
             }
-            if(!s){ cerr<<"ERROR 20: Structure not found"<<endl; exit(1); }
-            if (tokens[0]=="SPUSH") { if(tokens.size()<=paramStart){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); } pushStack(s, tokens[paramStart]); }
-            else if (tokens[0]=="SPOP") { try{ cout<<popStack(s)<<endl; } catch(...){ cerr<<"ERROR 40: Empty structure"<<endl; exit(1);} }
+            if(!s){ fail("ERROR 20: Structure not found"); }
+            touch(s, tokens[0]);
+            if (tokens[0]=="SPUSH") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument"); } pushStack(s, tokens[paramStart]); }
+            else if (tokens[0]=="SPOP") { try{ cout<<popStack(s)<<endl; } catch(...){ fail("ERROR 40: Empty structure");} }
             else if (tokens[0]=="SLEN") { cout << s->size << endl; }
-            else { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); }
-        } catch(...) { cerr<<"ERROR 40: Empty structure"<<endl; exit(1); }
+            else if (tokens[0]=="SMEM") { printListMemory(s->list->packed, s->list->pack, s->list->nodes.stats()); }
+            else { fail("ERROR 10: Unknown command"); }
+        } catch (const QueryError&) { throw; }
+        catch (...) { fail("ERROR 40: Empty structure"); }
     }
 
     void handleQCommand(const std::vector<std::string>& tokens) {
@@ -292,27 +648,30 @@ public:
                 if (tokens.size() > 1) {
                     name = tokens[1];
                 }
-                if(database.count(name)){ cerr<<"ERROR 21: Structure already exists"<<endl; exit(1);} Queue* q=new Queue(); q->name=name; database[name]=q; return;
+                if(exists(name)){ fail("ERROR 21: Structure already exists");} Queue* q=new Queue(); q->name=name; database[name]=q; return;
             }
             
             // Для других команд: определяем имя структуры и начальный индекс параметров
             std::string name="default";
             int paramStart = 1;
-            if (tokens.size() > 1 && database.count(tokens[1]) > 0) {
+            if (tokens.size() > 1 && exists(tokens[1])) {
                 name = tokens[1];
                 paramStart = 2;
             }
             // Auto-create if doesn't exist
             Queue* q=get<Queue>(name);
             if (!q && tokens[0] != "QCREATE") {
-                q = new Queue(); q->name=name; database[name]=q;
+                q = new Queue(); autoCreate(name, q);
             }
-            if(!q){ cerr<<"ERROR 20: Structure not found"<<endl; exit(1); }
-            if (tokens[0]=="QPUSH") { if(tokens.size()<=paramStart){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1);} enqueue(q, tokens[paramStart]); }
-            else if (tokens[0]=="QPOP") { try{ cout<<dequeue(q)<<endl; } catch(...){ cerr<<"ERROR 40: Empty structure"<<endl; exit(1);} }
+            if(!q){ fail("ERROR 20: Structure not found"); }
+            touch(q, tokens[0]);
+            if (tokens[0]=="QPUSH") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} enqueue(q, tokens[paramStart]); }
+            else if (tokens[0]=="QPOP") { try{ cout<<dequeue(q)<<endl; } catch(...){ fail("ERROR 40: Empty structure");} }
             else if (tokens[0]=="QLEN") { cout << q->size << endl; }
-            else { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); }
-        } catch(...) { cerr<<"ERROR 40: Empty structure"<<endl; exit(1); }
+            else if (tokens[0]=="QMEM") { printListMemory(q->list->packed, q->list->pack, q->list->nodes.stats()); }
+            else { fail("ERROR 10: Unknown command"); }
+        } catch (const QueryError&) { throw; }
+        catch (...) { fail("ERROR 40: Empty structure"); }
     }
 
     void handleTCommand(const std::vector<std::string>& tokens) {
@@ -323,33 +682,220 @@ public:
                 if (tokens.size() > 1) {
                     name = tokens[1];
                 }
-                if(database.count(name)){ cerr<<"ERROR 21: Structure already exists"<<endl; exit(1);} BTree* t=new BTree(); t->name=name; database[name]=t; return;
+                // Необязательные режимы в любом порядке: AVL - сбалансированное дерево,
+                // BPLUS - B+дерево с теми же командами, I64/STR - тип ключей (по умолчанию int32)
+                bool avl = false, bplus = false;
+                TreeKeyType keyType = TreeKeyType::INT32;
+                for (std::size_t i = 2; i < tokens.size(); ++i) {
+                    if (tokens[i] == "AVL" && !avl) avl = true;
+                    else if (tokens[i] == "BPLUS" && !bplus) bplus = true;
+                    else if (tokens[i] == "I64" && keyType == TreeKeyType::INT32) keyType = TreeKeyType::INT64;
+                    else if (tokens[i] == "STR" && keyType == TreeKeyType::INT32) keyType = TreeKeyType::STRING;
+                    else fail("ERROR 30: Invalid index/argument");
+                }
+                if (bplus && (avl || keyType != TreeKeyType::INT32)) fail("ERROR 30: Invalid index/argument");
+                if(exists(name)){ fail("ERROR 21: Structure already exists");}
+                if (bplus) { BPlusTree* b=new BPlusTree(); b->name=name; database[name]=b; return; }
+                if (keyType == TreeKeyType::INT64) database[name]=newTree<BTree64>(name, avl);
+                else if (keyType == TreeKeyType::STRING) database[name]=newTree<StringBTree>(name, avl);
+                else database[name]=newTree<BTree>(name, avl);
+                return;
             }
             
             // Для других команд: определяем имя структуры и начальный индекс параметров
             std::string name="default";
             int paramStart = 1;
-            if (tokens.size() > 1 && database.count(tokens[1]) > 0) {
+            if (tokens.size() > 1 && exists(tokens[1])) {
                 name = tokens[1];
                 paramStart = 2;
             }
+            // B+дерево обслуживает те же команды своим обработчиком
+            if (BPlusTree* b = get<BPlusTree>(name)) { touch(b, tokens[0]); handleBPlusCommand(b, tokens, paramStart); return; }
+            // Деревья ключей int64 и строк: те же команды, ключи разбираются по типу дерева
+            if (BTree64* t = get<BTree64>(name)) { touch(t, tokens[0]); handleTreeCommand(t, tokens, paramStart); return; }
+            if (StringBTree* t = get<StringBTree>(name)) { touch(t, tokens[0]); handleTreeCommand(t, tokens, paramStart); return; }
             // Auto-create if doesn't exist
             BTree* t=get<BTree>(name);
             if (!t && tokens[0] != "TCREATE") {
-                t = new BTree(); t->name=name; database[name]=t;
+                t = new BTree(); autoCreate(name, t);
+            }
+            if(!t){ fail("ERROR 20: Structure not found"); }
+            touch(t, tokens[0]);
+            handleTreeCommand(t, tokens, paramStart);
+        } catch (const QueryError&) { throw; }
+        catch (...) { fail("ERROR 10: Unknown command"); }
+    }
+
+    /** Новое пустое дерево с именем и режимом балансировки */
+    template<typename Tree>
+    static Tree* newTree(const std::string& name, bool balanced) {
+        Tree* t = new Tree();
+        t->name = name;
+        t->balanced = balanced;
+        return t;
+    }
+
+    /**
+     * Команды T... над бинарным деревом поиска. Аргументы-ключи разбираются
+     * по типу ключей дерева (parseTreeKey()), ключи выводятся как есть.
+     */
+    template<typename Tree>
+    void handleTreeCommand(Tree* t, const std::vector<std::string>& tokens, std::size_t paramStart) {
+        using Key = typename Tree::KeyType;
+        auto keyArg = [&](std::size_t i) { return parseTreeKey<Key>(tokens[i]); };
+        if (tokens[0]=="TINSERT") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} addNode(t, keyArg(paramStart)); }
+        else if (tokens[0]=="TSEARCH") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} cout<<(containsKey(*t, keyArg(paramStart))?"TRUE":"FALSE")<<endl; }
+        else if (tokens[0]=="TMSEARCH") {
+            std::vector<Key> keys;
+            for (const std::string& token : multiKeyTokens(tokens, paramStart)) keys.push_back(parseTreeKey<Key>(token));
+            std::vector<char> found;
+            containsKeys(*t, keys, found);
+            std::string line(found.size(), '0');
+            for (std::size_t i = 0; i < found.size(); ++i) if (found[i]) line[i] = '1';
+            cout<<line<<endl;
+        }
+        else if (tokens[0]=="TFREEZE") { freezeTree(t); }
+        // Порядковые запросы: ранги и номера считаются с нуля, диапазоны включают границы
+        else if (tokens[0]=="TRANK") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} cout<<rankKey(*t, keyArg(paramStart))<<endl; }
+        else if (tokens[0]=="TSELECT") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} int k=safeStoi(tokens[paramStart]); if(k<0 || static_cast<std::size_t>(k)>=treeSize(*t)){ fail("ERROR 30: Invalid index/argument");} cout<<selectKey(*t, static_cast<std::size_t>(k))<<endl; }
+        else if (tokens[0]=="TCOUNT") { if(tokens.size()<=paramStart+1){ fail("ERROR 30: Invalid index/argument");} cout<<countRange(*t, keyArg(paramStart), keyArg(paramStart+1))<<endl; }
+        else if (tokens[0]=="TRANGE") {
+            if(tokens.size()<=paramStart+1){ fail("ERROR 30: Invalid index/argument");}
+            std::string line;
+            {
+                Writer out(line);
+                scanRange(*t, keyArg(paramStart), keyArg(paramStart+1), [&](const Key& key){ writeTreeKey(out, key); out.put(' '); });
+            }
+            cout<<line<<endl;
+        }
+        else if (tokens[0]=="TCHECK") { cout<<(isFullTree(*t)?"TRUE":"FALSE")<<endl; }
+        else if (tokens[0]=="TLEN") { cout<<treeSize(*t)<<endl; }
+        else if (tokens[0]=="TLEAVES") { cout<<treeLeafCount(*t)<<endl; }
+        else if (t->frozen && tokens[0]=="TGETNODES") { handleFrozenRead(t, tokens, paramStart); }
+        else if (tokens[0]=="TDEL") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} deleteNode(t, keyArg(paramStart)); }
+        else if (tokens[0]=="TGET") {
+            if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");}
+            if(t->root==NO_NODE){ fail("ERROR 40: Empty structure");}
+            TreeOrder order = parseTreeOrder(tokens[paramStart]);
+            // Итеративный обход пишет ключи в буфер Writer, в cout уходят крупные порции
+            {
+                Writer out(cout);
+                TreeTraversal walk(*t, order);
+                while (const auto* n = walk.next()) { writeTreeKey(out, n->key); out.put(' '); }
+            }
+            cout<<endl;
+        }
+        else if (tokens[0]=="TGETNODES") { if(tokens.size()<=paramStart+1){ fail("ERROR 30: Invalid index/argument");} Key key=keyArg(paramStart); string mode=tokens[paramStart+1]; try{ BNodeIndex node=findNode(*t, key); BNodeIndex res=NO_NODE; if(mode=="PREV") res=findInOrderPredecessor(*t, node); else if(mode=="NEXT") res=findInOrderSuccessor(*t, node); else { fail("ERROR 10: Unknown command");} if(res==NO_NODE) cout<<endl; else cout<<t->nodes[res].key<<endl;} catch(const QueryError&){ throw; } catch(...){ fail("ERROR 30: Invalid index/argument"); } }
+        else { fail("ERROR 10: Unknown command"); }
+    }
+
+    /** Режим обхода TGET: PRE, IN, POST или BFS */
+    static TreeOrder parseTreeOrder(const std::string& mode) {
+        if (mode == "PRE") return TreeOrder::PRE;
+        if (mode == "IN") return TreeOrder::IN;
+        if (mode == "POST") return TreeOrder::POST;
+        if (mode == "BFS") return TreeOrder::BFS;
+        fail("ERROR 10: Unknown command");
+    }
+
+    /**
+     * TGETNODES замороженного дерева по массиву frozenKeys, без размораживания:
+     * соседи по порядку находятся переходами по индексам Эйтцингера.
+     */
+    template<typename Tree>
+    void handleFrozenRead(const Tree* t, const std::vector<std::string>& tokens, std::size_t paramStart) {
+        using Key = typename Tree::KeyType;
+        const std::vector<Key>& keys = t->frozenKeys;
+        if(tokens.size()<=paramStart+1){ fail("ERROR 30: Invalid index/argument");}
+        Key key=parseTreeKey<Key>(tokens[paramStart]); const std::string& mode=tokens[paramStart+1];
+        std::size_t k = frozenLowerBound(*t, key);
+        if(k==0 || !Tree::equal(keys[k], key)){ fail("ERROR 30: Invalid index/argument");}
+        if(mode=="PREV") k=frozenPredecessor(*t, k); else if(mode=="NEXT") k=frozenSuccessor(*t, k); else { fail("ERROR 10: Unknown command");}
+        if(k==0) cout<<endl; else cout<<keys[k]<<endl;
+    }
+
+    /**
+     * Команды T... над B+деревом. TGET поддерживает только режим IN
+     * (ключи по возрастанию): PRE/POST/BFS описывают форму бинарного дерева.
+     * TRANGE lo hi - ключи из [lo, hi] по возрастанию.
+     * TMSEARCH k1 k2 ... - строка из '0'/'1' по наличию каждого ключа.
+     * TRANK/TSELECT/TCOUNT - как у BTree, по счетчикам ключей внутренних узлов.
+     * TLEAVES - количество листьев B+дерева; TFREEZE ничего не делает: ключи
+     * и так лежат отсортированными массивами в листьях.
+     * TCHECK (полнота бинарного дерева) для B+дерева не определена:
+     * "ERROR 10: Unsupported for BPLUS tree".
+     */
+    void handleBPlusCommand(BPlusTree* b, const std::vector<std::string>& tokens, std::size_t paramStart) {
+        const std::string& cmd = tokens[0];
+        if (cmd=="TINSERT") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} insertKeyBPlus(b, safeStoi(tokens[paramStart])); }
+        else if (cmd=="TSEARCH") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} cout<<(containsKeyBPlus(*b, safeStoi(tokens[paramStart]))?"TRUE":"FALSE")<<endl; }
+        else if (cmd=="TMSEARCH") {
+            std::vector<int> keys;
+            for (const std::string& token : multiKeyTokens(tokens, paramStart)) keys.push_back(safeStoi(token));
+            std::vector<char> found;
+            containsKeysBPlus(*b, keys, found);
+            std::string line(found.size(), '0');
+            for (std::size_t i = 0; i < found.size(); ++i) if (found[i]) line[i] = '1';
+            cout<<line<<endl;
+        }
+        else if (cmd=="TDEL") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} deleteKeyBPlus(b, safeStoi(tokens[paramStart])); }
+        else if (cmd=="TLEN") { cout<<b->size<<endl; }
+        else if (cmd=="TLEAVES") { cout<<leafCountBPlus(*b)<<endl; }
+        else if (cmd=="TFREEZE") {}
+        else if (cmd=="TCHECK") { fail("ERROR 10: Unsupported for BPLUS tree"); }
+        else if (cmd=="TRANK") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} cout<<rankKeyBPlus(*b, safeStoi(tokens[paramStart]))<<endl; }
+        else if (cmd=="TSELECT") { if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");} int k=safeStoi(tokens[paramStart]); if(k<0 || static_cast<std::size_t>(k)>=b->size){ fail("ERROR 30: Invalid index/argument");} cout<<selectKeyBPlus(*b, static_cast<std::size_t>(k))<<endl; }
+        else if (cmd=="TCOUNT") { if(tokens.size()<=paramStart+1){ fail("ERROR 30: Invalid index/argument");} cout<<countRangeBPlus(*b, safeStoi(tokens[paramStart]), safeStoi(tokens[paramStart+1]))<<endl; }
+        else if (cmd=="TGET") {
+            if(tokens.size()<=paramStart){ fail("ERROR 30: Invalid index/argument");}
+            if(b->root==nullptr){ fail("ERROR 40: Empty structure");}
+            if(tokens[paramStart]!="IN"){ fail("ERROR 10: Unknown command");}
+            std::string line;
+            for (const BPlusLeaf* leaf = b->first; leaf; leaf = leaf->next) {
+                for (int i = 0; i < leaf->count; ++i) { line += std::to_string(leaf->keys[i]); line += ' '; }
             }
-            if(!t){ cerr<<"ERROR 20: Structure not found"<<endl; exit(1); }
-            if (tokens[0]=="TINSERT") { if(tokens.size()<=paramStart){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1);} int key=safeStoi(tokens[paramStart]); addNode(t, key); }
-            else if (tokens[0]=="TSEARCH") { if(tokens.size()<=paramStart){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1);} int key=safeStoi(tokens[paramStart]); try{ findNode(*t, key); cout<<"TRUE"<<endl;} catch(...){ cout<<"FALSE"<<endl; } }
-            else if (tokens[0]=="TCHECK") { cout<<(t->root==nullptr?"TRUE":(isFullTree(*t)?"TRUE":"FALSE"))<<endl; }
-            else if (tokens[0]=="TDEL") { if(tokens.size()<=paramStart){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1);} int key=safeStoi(tokens[paramStart]); deleteNode(t, key); }
-            else if (tokens[0]=="TGET") { if(tokens.size()<=paramStart){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1);} string mode=tokens[paramStart]; if(t->root==nullptr){ cerr<<"ERROR 40: Empty structure"<<endl; exit(1);} if(mode=="PRE"){ function<void(BNode*)> pre=[&](BNode* n){ if(n){ cout<<n->key<<" "; pre(n->left); pre(n->right);} }; pre(t->root); cout<<endl;} else if(mode=="IN"){ function<void(BNode*)> in=[&](BNode* n){ if(n){ in(n->left); cout<<n->key<<" "; in(n->right);} }; in(t->root); cout<<endl;} else if(mode=="POST"){ function<void(BNode*)> post=[&](BNode* n){ if(n){ post(n->left); post(n->right); cout<<n->key<<" ";} }; post(t->root); cout<<endl;} else if(mode=="BFS"){ vector<BNode*> q; q.push_back(t->root); size_t i=0; while(i<q.size()){ BNode* n=q[i++]; cout<<n->key<<" "; if(n->left) q.push_back(n->left); if(n->right) q.push_back(n->right);} cout<<endl;} else { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); } }
-            else if (tokens[0]=="TGETNODES") { if(tokens.size()<=paramStart+1){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1);} int key=safeStoi(tokens[paramStart]); string mode=tokens[paramStart+1]; try{ BNode* node=findNode(*t, key); BNode* res=nullptr; if(mode=="PREV") res=findInOrderPredecessor(node); else if(mode=="NEXT") res=findInOrderSuccessor(node); else { cerr<<"ERROR 10: Unknown command"<<endl; exit(1);} if(!res) cout<<endl; else cout<<res->key<<endl;} catch(...){ cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); } }
-            else { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); }
-        } catch(...) { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); }
+            cout<<line<<endl;
+        }
+        else if (cmd=="TRANGE") {
+            if(tokens.size()<=paramStart+1){ fail("ERROR 30: Invalid index/argument");}
+            int lo=safeStoi(tokens[paramStart]); int hi=safeStoi(tokens[paramStart+1]);
+            std::string line;
+            scanRangeBPlus(*b, lo, hi, [&](int key){ line += std::to_string(key); line += ' '; });
+            cout<<line<<endl;
+        }
+        else if (cmd=="TGETNODES") {
+            if(tokens.size()<=paramStart+1){ fail("ERROR 30: Invalid index/argument");}
+            int key=safeStoi(tokens[paramStart]); const std::string& mode=tokens[paramStart+1];
+            BPlusCursor c = lowerBoundBPlus(*b, key);
+            if(!c.leaf || c.leaf->keys[c.pos]!=key){ fail("ERROR 30: Invalid index/argument");}
+            if(mode=="PREV") prevBPlus(c); else if(mode=="NEXT") nextBPlus(c); else { fail("ERROR 10: Unknown command");}
+            if(!c.leaf) cout<<endl; else cout<<c.leaf->keys[c.pos]<<endl;
+        }
+        else { fail("ERROR 10: Unknown command"); }
     }
 };
 
+/**
+ * @brief Проверяет, изменяет ли команда состояние структур.
+ *
+ * Такие команды записываются в журнал мутаций. Команды чтения (MGET, FSEARCH,
+ * TGET, QLEN, PRINT, ...) в журнал не попадают.
+ */
+bool isMutatingCommand(const std::string& cmd) {
+    static const char* const mutating[] = {
+        "MCREATE", "MPUSH", "MPUSHAT", "MDEL", "MSET",
+        "FCREATE", "FPUSH", "FDEL", "FDELVAL", "FINDEX",
+        "LCREATE", "LPUSH", "LDEL", "LDELVAL", "LINDEX",
+        "SCREATE", "SPUSH", "SPOP",
+        "QCREATE", "QPUSH", "QPOP",
+        "TCREATE", "TINSERT", "TDEL", "TFREEZE",
+    };
+    for (const char* name : mutating) {
+        if (cmd == name) return true;
+    }
+    return false;
+}
+
 // processQuery: split query and dispatch to manager
 void processQuery(const std::string& query, StructureManager& manager) {
     // Разбор запроса: разбиваем на токены
@@ -357,27 +903,228 @@ void processQuery(const std::string& query, StructureManager& manager) {
     std::vector<std::string> tokens;
     std::string tok;
     while (iss >> tok) tokens.push_back(tok);
-    if (tokens.empty()) { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); }
+    if (tokens.empty()) { fail("ERROR 10: Unknown command"); }
 
     std::string cmd = tokens[0];
     char c = cmd[0]; // Первый символ определяет тип структуры
 
     // Специальная команда PRINT: выводит содержимое структуры
     if (cmd == "PRINT") {
-        if (tokens.size() < 2) { cerr<<"ERROR 30: Invalid index/argument"<<endl; exit(1); }
+        if (tokens.size() < 2) { fail("ERROR 30: Invalid index/argument"); }
         manager.printCurrentStructure(tokens[1]);
         return;
     }
 
     // Диспетчеризация команд по первому символу:
-    // M - Array, F - ForwardList, L - DoubleList, S - Stack, Q - Queue, T - BTree
-    if (c == 'M') manager.handleMCommand(tokens);
-    else if (c == 'F') manager.handleFCommand(tokens);
-    else if (c == 'L') manager.handleLCommand(tokens);
-    else if (c == 'S') manager.handleSCommand(tokens);
-    else if (c == 'Q') manager.handleQCommand(tokens);
-    else if (c == 'T') manager.handleTCommand(tokens);
-    else { cerr<<"ERROR 10: Unknown command"<<endl; exit(1); }
+    // M - Array, F - ForwardList, L - DoubleList, S - Stack, Q - Queue, T - BTree или BPlusTree
+    // Структура, автоматически созданная командой с ошибкой, не остается в базе
+    std::size_t countBefore = manager.structureCount();
+    manager.beginCommand();
+    try {
+        if (c == 'M') manager.handleMCommand(tokens);
+        else if (c == 'F') manager.handleFCommand(tokens);
+        else if (c == 'L') manager.handleLCommand(tokens);
+        else if (c == 'S') manager.handleSCommand(tokens);
+        else if (c == 'Q') manager.handleQCommand(tokens);
+        else if (c == 'T') manager.handleTCommand(tokens);
+        else { fail("ERROR 10: Unknown command"); }
+    } catch (...) {
+        manager.discardAutoCreated();
+        throw;
+    }
+    manager.keepAutoCreated();
+
+    // Команда чтения тоже может изменить базу, автоматически создав структуру
+    if (isMutatingCommand(cmd) || manager.structureCount() != countBefore) {
+        manager.recordMutation(query);
+    }
+}
+
+/**
+ * @brief Выполняет команду, перехватывая ее вывод вместо печати в консоль.
+ *
+ * Используется резидентным режимом: вывод команды и сообщение об ошибке
+ * возвращаются клиенту, а ошибка не завершает процесс.
+ *
+ * @param query Строка команды
+ * @param manager Менеджер структур
+ * @param output Вывод команды (при ошибке - вместе с сообщением "ERROR ...")
+ * @return true если команда выполнена успешно
+ */
+bool processQueryCaptured(const std::string& query, StructureManager& manager, std::string& output) {
+    std::ostringstream captured;
+    std::streambuf* saved = cout.rdbuf(captured.rdbuf());
+    bool ok = true;
+    try {
+        processQuery(query, manager);
+    } catch (const QueryError& e) {
+        captured << e.what() << '\n';
+        ok = false;
+    } catch (...) {
+        captured << "ERROR 10: Unknown command" << '\n';
+        ok = false;
+    }
+    cout.rdbuf(saved);
+    output = captured.str();
+    return ok;
+}
+
+/**
+ * @brief Пакетный режим: выполняет команды из потока, по одной на строку.
+ *
+ * Ошибка в команде не прерывает пакет: сообщение печатается в stderr
+ * с номером строки ("line 3: ERROR 20: Structure not found"), и выполнение
+ * продолжается со следующей строки. Пустые строки и строки, начинающиеся
+ * с '#', пропускаются. Пакет читается целиком до выполнения: структуры,
+ * которые он называет, загружаются из файла параллельно (prefetch()).
+ *
+ * @param in Поток с командами (файл --script или stdin)
+ * @param manager Менеджер структур (загружается и сохраняется вызывающей стороной)
+ * @return Количество команд, завершившихся ошибкой
+ */
+int runScript(std::istream& in, StructureManager& manager) {
+    std::vector<std::string> commands;
+    std::vector<int> lineNumbers;
+    int lineNo = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') continue;
+        commands.push_back(line);
+        lineNumbers.push_back(lineNo);
+    }
+    manager.prefetch(commands);
+
+    int errors = 0;
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+        try {
+            processQuery(commands[i], manager);
+        } catch (const QueryError& e) {
+            cerr << "line " << lineNumbers[i] << ": " << e.what() << endl;
+            ++errors;
+        } catch (...) {
+            cerr << "line " << lineNumbers[i] << ": ERROR 10: Unknown command" << endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+/**
+ * @brief Политика сохранения базы в резидентном режиме (--persist).
+ *
+ *  always - после каждой пачки команд (поведение, эквивалентное --query)
+ *  <N>    - после каждых N выполненных команд
+ *  exit   - только по командам SAVE/SHUTDOWN и при завершении процесса
+ */
+struct PersistPolicy {
+    enum Mode { ALWAYS, EVERY_N, ON_EXIT } mode = ALWAYS;
+    long everyN = 0;
+};
+
+/**
+ * @brief Разбирает политику fsync (--fsync): always, never или интервал в миллисекундах.
+ */
+FsyncPolicy parseFsyncPolicy(const std::string& value) {
+    FsyncPolicy policy;
+    if (value == "always") { policy.mode = FsyncPolicy::ALWAYS; return policy; }
+    if (value == "never") { policy.mode = FsyncPolicy::NEVER; return policy; }
+    policy.mode = FsyncPolicy::PERIODIC;
+    policy.intervalMs = safeStoi(value);
+    if (policy.intervalMs < 1) fail("ERROR 30: Invalid index/argument");
+    return policy;
+}
+
+PersistPolicy parsePersistPolicy(const std::string& value) {
+    PersistPolicy policy;
+    if (value == "always") { policy.mode = PersistPolicy::ALWAYS; return policy; }
+    if (value == "exit") { policy.mode = PersistPolicy::ON_EXIT; return policy; }
+    policy.mode = PersistPolicy::EVERY_N;
+    policy.everyN = safeStoi(value);
+    if (policy.everyN < 1) fail("ERROR 30: Invalid index/argument");
+    return policy;
+}
+
+/**
+ * @brief Разбирает числовое значение флага командной строки (--threads и т.п.).
+ * @param value Строка аргумента
+ * @param n Разобранное число
+ * @return false, если строка - не десятичное число целиком или число не помещается в 64 бита
+ */
+bool parseCountArg(const char* value, std::uint64_t& n) {
+    if (!std::isdigit(static_cast<unsigned char>(value[0]))) return false;
+    errno = 0;
+    char* end = nullptr;
+    n = std::strtoull(value, &end, 10);
+    return *end == '\0' && errno != ERANGE;
+}
+
+/**
+ * @brief Резидентный режим: база загружается один раз и живет в памяти процесса.
+ *
+ * Кроме команд над структурами сервер понимает:
+ *  SAVE     - немедленно сохранить базу в файл
+ *  SHUTDOWN - сохранить базу и завершить процесс
+ *  QUIT     - закрыть текущее подключение
+ * Если сохранение не удалось, SAVE и SHUTDOWN возвращают клиенту ошибку,
+ * а сервер продолжает работу с несохраненными изменениями в памяти.
+ */
+void runServeMode(const std::string& socketPath, StructureManager& manager, const PersistPolicy& policy,
+                  const FsyncPolicy& fsyncPolicy) {
+    long sinceSave = 0;
+
+    // Ошибка сохранения не останавливает сервер: несохраненные изменения
+    // остаются в памяти, и сохранение можно повторить
+    bool saveFailing = false;
+
+    ServerHooks hooks;
+    hooks.onCommand = [&](const std::string& line, std::string& output) {
+        if (line == "SAVE" || line == "SHUTDOWN") {
+            // Ошибка возвращается клиенту; SHUTDOWN при ошибке не завершает процесс
+            try {
+                if (line == "SAVE") manager.saveCurrentStructure();
+                else manager.commit();
+            } catch (const QueryError& e) {
+                output = std::string(e.what()) + '\n';
+                return false;
+            }
+            if (line == "SAVE") sinceSave = 0;
+            else requestServerStop();
+            saveFailing = false;
+            return true;
+        }
+        ++sinceSave;
+        return processQueryCaptured(line, manager, output);
+    };
+    hooks.onBatchEnd = [&]() {
+        try {
+            // С журналом мутаций команды уже дописаны: один fsync на всю пачку
+            // (ответы клиентам уходят после него) и завершение фонового уплотнения
+            if (manager.isMutationLogEnabled()) { manager.commit(false); return; }
+            if (sinceSave == 0) return;
+            if (policy.mode == PersistPolicy::ALWAYS ||
+                (policy.mode == PersistPolicy::EVERY_N && sinceSave >= policy.everyN)) {
+                manager.saveCurrentStructure();
+                sinceSave = 0;
+                saveFailing = false;
+            }
+        } catch (const QueryError& e) {
+            // Ответить на ошибку некому: она пишется в stderr сервера (один раз до
+            // успешного сохранения), а сохранение повторяется после следующей пачки
+            if (!saveFailing) cerr << "save failed: " << e.what() << endl;
+            saveFailing = true;
+        }
+    };
+
+    // При периодическом fsync пачка по таймауту должна наступать не реже интервала
+    int idleTimeoutMs = 1000;
+    if (fsyncPolicy.mode == FsyncPolicy::PERIODIC && fsyncPolicy.intervalMs < idleTimeoutMs) {
+        idleTimeoutMs = static_cast<int>(fsyncPolicy.intervalMs);
+    }
+    runServer(socketPath, hooks, idleTimeoutMs);
+    manager.commit();
 }
 
 /**
@@ -387,23 +1134,49 @@ void processQuery(const std::string& query, StructureManager& manager) {
  *  1. Каждый вызов program - независимый
  *  2. Цикл: Загрузи → Выполни → Сохрани → Выход
  *  3. Файл хранит ВСЕ структуры (база данных структур)
- *  4. После выполнения команды - весь файл переписывается
+ *  4. После мутирующей команды файл переписывается: измененные структуры
+ *     сериализуются заново, остальные копируются из старого файла;
+ *     после команд чтения файл не трогается
  * 
  * Аргументы:
- *  --file <path>     - Файл для хранения структур данных
- *  --query '<cmd>'   - Команда для выполнения
- *  --help            - Показать справку
+ *  --file <path>       - Файл для хранения структур данных
+ *  --query '<cmd>'     - Команда для выполнения
+ *  --format <fmt>      - Формат сохранения: text или binary (по умолчанию - формат существующего файла, иначе text)
+ *  --log               - Вести журнал мутаций <file>.log вместо полной перезаписи файла после команд
+ *  --compact-threshold <bytes> - Размер журнала, после которого он уплотняется в новый снимок (по умолчанию 16 МиБ)
+ *  --script <path>     - Выполнить команды из файла (по одной на строку) с одной загрузкой и одним сохранением
+ *  --stdin             - То же, что --script, но команды читаются из стандартного ввода
+ *  --serve <socket>    - Резидентный режим: база остается в памяти, команды принимаются через Unix-сокет
+ *  --persist <policy>  - Политика сохранения в режиме --serve: always (по умолчанию), <N>, exit
+ *  --connect <socket>  - Отправить --query запущенному серверу вместо локального выполнения
+ *  --fsync <policy>    - Сброс на диск: always (по умолчанию), <ms> - журнал не чаще раза в ms мс, never
+ *  --threads <n>       - Число потоков для параллельного разбора структур пакета (--script, --stdin) и сериализации при сохранении (по умолчанию - число ядер)
+ *  --list-max-entries <n>    - Списки, стеки и очереди до n элементов хранятся компактно (по умолчанию 128, 0 - выключить)
+ *  --list-max-value <bytes>  - Наибольшая длина элемента в компактном представлении (по умолчанию 64, не больше 255)
+ *  --help              - Показать справку
  * 
  * Примеры:
  *  ./lab1 --file db.txt --query "MCREATE"        # Создать новый массив
  *  ./lab1 --file db.txt --query "MPUSH 10"       # Добавить элемент
  *  ./lab1 --file db.txt --query "MLEN"           # Получить длину
  *  ./lab1 --file db.txt --query "PRINT default"  # Вывести содержимое
+ *  ./lab1 --file db.txt --script ingest.txt      # Выполнить пакет команд
+ *  ./lab1 --file db.txt --serve /tmp/lab1.sock --persist 100 &
+ *  ./lab1 --connect /tmp/lab1.sock --query "MPUSH 10"
  */
 int main(int argc, char* argv[]) {
     string filename;
     string query;
+    bool useLog = false;
+    std::uint64_t compactThreshold = 16 * 1024 * 1024;
+    string scriptFile;
+    bool readStdin = false;
+    string serveSocket;
+    string connectSocket;
+    string persist = "always";
+    string fsyncMode = "always";
     StructureManager manager;
+    ListPackLimits packLimits;
     bool helpRequested = false;
     
     // === Этап 1: Парсинг аргументов командной строки ===
@@ -414,24 +1187,85 @@ int main(int argc, char* argv[]) {
             manager.setFilename(filename);
         } else if (arg == "--query" && i + 1 < argc) {
             query = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            string fmt = argv[++i];
+            if (fmt == "binary") manager.setFormat(DatabaseFormat::Binary);
+            else if (fmt == "text") manager.setFormat(DatabaseFormat::Text);
+            else { cerr << "ERROR 30: Invalid index/argument" << endl; return 1; }
+        } else if (arg == "--log") {
+            useLog = true;
+        } else if (arg == "--compact-threshold" && i + 1 < argc) {
+            if (!parseCountArg(argv[++i], compactThreshold) || compactThreshold == 0) { cerr << "ERROR 30: Invalid index/argument" << endl; return 1; }
+        } else if (arg == "--script" && i + 1 < argc) {
+            scriptFile = argv[++i];
+        } else if (arg == "--stdin") {
+            readStdin = true;
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveSocket = argv[++i];
+        } else if (arg == "--persist" && i + 1 < argc) {
+            persist = argv[++i];
+        } else if (arg == "--connect" && i + 1 < argc) {
+            connectSocket = argv[++i];
+        } else if (arg == "--fsync" && i + 1 < argc) {
+            fsyncMode = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            std::uint64_t threads = 0;
+            if (!parseCountArg(argv[++i], threads) || threads == 0) { cerr << "ERROR 30: Invalid index/argument" << endl; return 1; }
+            setThreadPoolSize(threads);
+        } else if (arg == "--list-max-entries" && i + 1 < argc) {
+            std::uint64_t entries = 0;
+            if (!parseCountArg(argv[++i], entries)) { cerr << "ERROR 30: Invalid index/argument" << endl; return 1; }
+            packLimits.maxEntries = entries;
+        } else if (arg == "--list-max-value" && i + 1 < argc) {
+            std::uint64_t maxValue = 0;
+            if (!parseCountArg(argv[++i], maxValue)) { cerr << "ERROR 30: Invalid index/argument" << endl; return 1; }
+            packLimits.maxValue = maxValue;
         } else if (arg == "--help") {
             helpRequested = true;
         }
     }
     
+    if (readStdin || !serveSocket.empty()) stdinKeysAllowed = false;
+    if (useLog) manager.enableMutationLog(compactThreshold);
+    setListPackLimits(packLimits);
+
     // === Этап 2: STATELESS режим ===
     // Каждый вызов программы выполняет цикл: Load → Execute → Save → Exit
     try {
         // Обработка --help
         if (helpRequested) {
-            cout << "Usage: ./lab1 --file <path> --query '<COMMAND> <ARGS...>'" << endl;
+            cout << "Usage: ./lab1 --file <path> [--format text|binary] [--log [--compact-threshold <bytes>]] [--fsync always|<ms>|never] [--threads <n>] [--list-max-entries <n>] [--list-max-value <bytes>] --query '<COMMAND> <ARGS...>'" << endl;
+            cout << "       ./lab1 --file <path> --script <commands.txt> | --stdin" << endl;
+            cout << "       ./lab1 --file <path> --serve <socket> [--persist always|<N>|exit]" << endl;
+            cout << "       ./lab1 --connect <socket> --query '<COMMAND> <ARGS...>'" << endl;
+            cout << "BPLUS trees (TCREATE <name> BPLUS) accept every T command except TCHECK (ERROR 10: Unsupported for BPLUS tree);" << endl;
+            cout << "TGET takes IN only, TLEAVES counts B+ leaves, TFREEZE is a no-op." << endl;
             return 0;
         }
+
+        // Клиент резидентного режима: команда выполняется сервером, база не загружается
+        if (!connectSocket.empty()) {
+            if (query.empty()) fail("ERROR 10: Unknown command");
+            string output;
+            bool ok = false;
+            try {
+                ok = sendServerCommand(connectSocket, query, output);
+            } catch (const std::runtime_error& e) {
+                // Ошибка соединения, а не команды: сообщение транспорта как есть
+                cerr << e.what() << endl;
+                return 1;
+            }
+            (ok ? cout : cerr) << output << flush;
+            return ok ? 0 : 1;
+        }
         
+        FsyncPolicy fsyncPolicy = parseFsyncPolicy(fsyncMode);
+        manager.setFsyncPolicy(fsyncPolicy);
+
         // Этап A: ЗАГРУЗКА (Десериализация)
         // Если файл существует, загружаем всю базу данных структур из файла
         if (!filename.empty()) {
-            if (fileExists(filename)) {
+            if (fileExists(filename) || fileExists(mutationLogPath(filename))) {
                 // Загружаем ВСЕ структуры из файла в map<name, Structure*>
                 if (!manager.loadStructuresFromFile(filename)) {
                     cerr << "ERROR 10: Unknown command" << endl;
@@ -440,6 +1274,29 @@ int main(int argc, char* argv[]) {
             }
         }
         
+        // Резидентный режим: вместо одной команды обслуживаем подключения до SHUTDOWN
+        if (!serveSocket.empty()) {
+            runServeMode(serveSocket, manager, parsePersistPolicy(persist), fsyncPolicy);
+            return 0;
+        }
+
+        // Пакетный режим: все команды пакета выполняются над одной загруженной базой,
+        // база сохраняется один раз в конце (в том числе если часть команд завершилась ошибкой)
+        if (!scriptFile.empty() || readStdin) {
+            int errors = 0;
+            if (readStdin) {
+                errors = runScript(cin, manager);
+            } else {
+                std::ifstream script(scriptFile);
+                if (!script.is_open()) fail("ERROR 10: Unknown command");
+                errors = runScript(script, manager);
+            }
+            if (!filename.empty()) {
+                manager.commit();
+            }
+            return errors == 0 ? 0 : 1;
+        }
+
         // Этап B: ВЫПОЛНЕНИЕ
         // Парсим и выполняем одну команду из --query
         if (!query.empty()) {
@@ -451,11 +1308,14 @@ int main(int argc, char* argv[]) {
         }
         
         // Этап C: СОХРАНЕНИЕ (Сериализация)
-        // Сохраняем ВСЮ базу данных в файл (все структуры с их новым состоянием)
+        // Сохраняем базу, если команда ее изменила (только измененные структуры сериализуются заново)
         if (!filename.empty()) {
-            manager.saveCurrentStructure();
+            manager.commit();
         }
         
+    } catch (const QueryError& e) {
+        cerr << e.what() << endl;
+        return 1;
     } catch (...) {
         cerr << "ERROR 10: Unknown command" << endl;
         return 1;